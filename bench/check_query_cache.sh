@@ -0,0 +1,59 @@
+#!/bin/sh
+# проверка ключей кэша запросов на Linux: ./check_query_cache.sh [--docs 2000] [--seed 42]
+# Синтетический корпус проходит весь конвейер, затем для каждой пары запросов A, B ответ
+# searcher.exe на B сразу после A (B может взяться из кэша) сравнивается с ответом на B
+# в отдельном запуске. Пары - запросы с разным смыслом, чьи ключи кэша когда-то совпадали.
+# Всё собирается и запускается во временном каталоге, дерево репозитория не меняется.
+set -e
+src=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work"
+g++ -std=c++17 -O2 "$src/bench/gen_corpus.cpp" -o gen_corpus.exe
+g++ -std=c++17 -O2 "$src/preprocessor/tokenizer.cpp" -o tokenizer.exe
+g++ -std=c++17 -O2 "$src/preprocessor/stemmer.cpp" -o stemmer.exe
+g++ -std=c++17 -O2 "$src/searcher/indexer.cpp" -o indexer.exe
+g++ -std=c++17 -O2 -I/usr/include/postgresql "$src/searcher/searcher.cpp" -o searcher.exe -lpq -pthread
+
+out=cache_check
+./gen_corpus.exe --out "$out" "$@" > /dev/null
+cd "$out/preprocessor"
+cp "$src/preprocessor/known_abbrevs.txt" "$src/preprocessor/stop_words.txt" .
+../../tokenizer.exe > /dev/null
+../../stemmer.exe > /dev/null
+cd ../searcher
+# атрибуты для source: и date: - у всех документов один источник и одна дата
+ls ../preprocessor/docs | sed 's/\.txt$//' | awk '{ print $1 "\texample.org\t2020-01-01" }' > doc_attributes.txt
+../../indexer.exe --positions > /dev/null
+word=$(grep -v ' ' queries.txt | head -n 1)
+
+ask() {
+    printf '%s' "$1" | ../../searcher.exe --ids-only 2>/dev/null
+}
+
+failed=0
+check() {
+    ask "" > empty.txt
+    ask "$1
+" > a.txt
+    ask "$2
+" > b.txt
+    ask "$1
+$2
+" > ab.txt
+    tail -c +$(($(wc -c < empty.txt) + 1)) b.txt | cat a.txt - > expected.txt
+    if cmp -s ab.txt expected.txt; then
+        echo "OK   $1 -> $2"
+    else
+        echo "FAIL $1 -> $2"
+        failed=1
+    fi
+}
+
+check "\"$word~1\"" "$word~1"
+check "$word~1" "\"$word~1\""
+check "$word" "$word*"
+check "\"source:example.org\"" "source:example.org"
+check "source:example.org" "\"source:example.org\""
+check "\"date:2020\"" "date:2020"
+exit $failed
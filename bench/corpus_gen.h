@@ -0,0 +1,158 @@
+// Детерминированный синтетический корпус для бенчмарков: русскоподобные документы
+// и наборы запросов, частоты слов по закону Ципфа (как у корпуса, см. preprocessor/zipf.py).
+//
+// Результат зависит только от параметров и seed: генератор - mt19937_64, равномерные числа
+// и выбор по распределению считаются здесь, а не через std::*_distribution, поведение которых
+// у разных стандартных библиотек различается.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+struct CorpusParams {
+    uint64_t seed = 42;
+    size_t vocabulary = 50000;   // различных слов
+    size_t docs = 2000;
+    size_t min_words = 80;       // слов в документе
+    size_t max_words = 400;
+    double zipf_s = 1.0;         // показатель Ципфа: частота ранга r ~ 1 / r^s
+};
+
+class SyntheticCorpus {
+public:
+    explicit SyntheticCorpus(const CorpusParams& params) : params_(params), rng_(params.seed) {
+        build_vocabulary();
+        build_cdf();
+    }
+
+    const std::vector<std::string>& vocabulary() const { return words_; }
+
+    // слово по рангу частоты (0 - самое частое)
+    size_t sample_rank() {
+        double u = uniform();
+        return static_cast<size_t>(std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin());
+    }
+
+    // документ: предложения с заглавной буквой, запятыми и точками, изредка числа и латиница
+    std::string document() {
+        size_t words = params_.min_words + next() % (params_.max_words - params_.min_words + 1);
+        std::string text;
+        size_t sentence_left = 0;
+        for (size_t i = 0; i < words; ++i) {
+            bool sentence_start = sentence_left == 0;
+            if (sentence_start) sentence_left = 5 + next() % 11;
+            --sentence_left;
+
+            std::string word;
+            uint64_t kind = next() % 100;
+            if (kind == 0) {
+                word = std::to_string(1 + next() % 2025);
+            } else if (kind == 1) {
+                word = LATIN_WORDS[next() % (sizeof(LATIN_WORDS) / sizeof(LATIN_WORDS[0]))];
+            } else {
+                word = words_[std::min(sample_rank(), words_.size() - 1)];
+            }
+            if (sentence_start) word = capitalize(word);
+            text += word;
+            if (sentence_left == 0) {
+                text += ". ";
+            } else {
+                text += next() % 12 == 0 ? ", " : " ";
+            }
+        }
+        text += "\n";
+        return text;
+    }
+
+    // содержательное слово для запроса: частотное по Ципфу, но не из служебных
+    const std::string& query_word() {
+        while (true) {
+            size_t rank = sample_rank();
+            if (rank >= FUNCTION_WORD_COUNT && rank < words_.size()) return words_[rank];
+        }
+    }
+
+    uint64_t next() { return rng_(); }
+
+    // [0, 1)
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+private:
+    static constexpr size_t FUNCTION_WORD_COUNT = 40;
+    static constexpr const char* FUNCTION_WORDS[FUNCTION_WORD_COUNT] = {
+        "и", "в", "не", "на", "что", "с", "как", "а", "то", "все", "по", "это", "но", "к", "у",
+        "же", "за", "из", "от", "так", "для", "о", "бы", "только", "его", "ее", "мы", "вы",
+        "она", "они", "уже", "если", "или", "ни", "быть", "был", "до", "при", "когда", "может"};
+    static constexpr const char* LATIN_WORDS[6] = {"covid", "mama", "baby", "online", "blog", "ok"};
+
+    static constexpr const char* CONSONANTS[20] = {"б", "в", "г", "д", "ж", "з", "к", "л", "м", "н",
+                                                   "п", "р", "с", "т", "ф", "х", "ц", "ч", "ш", "щ"};
+    static constexpr const char* VOWELS[9] = {"а", "е", "и", "о", "у", "ы", "э", "ю", "я"};
+    static constexpr const char* ENDINGS[24] = {"", "", "", "а", "ы", "ой", "ами", "ость", "ение", "ания",
+                                                "ать", "ить", "ет", "ют", "ый", "ая", "ое", "ие", "ого",
+                                                "ому", "ов", "ах", "ческий", "ками"};
+
+    // частые ранги - служебные слова, остальные - случайные корни из слогов с окончаниями;
+    // короткие слова попадают на верхние ранги, как в живом языке
+    void build_vocabulary() {
+        for (size_t i = 0; i < FUNCTION_WORD_COUNT && words_.size() < params_.vocabulary; ++i) {
+            words_.push_back(FUNCTION_WORDS[i]);
+        }
+        std::vector<std::string> seen(words_);
+        std::sort(seen.begin(), seen.end());
+        while (words_.size() < params_.vocabulary) {
+            size_t rank = words_.size();
+            size_t syllables = 1 + next() % (rank < 1000 ? 2 : 4);
+            std::string word;
+            for (size_t s = 0; s < syllables; ++s) {
+                word += CONSONANTS[next() % 20];
+                word += VOWELS[next() % 9];
+                if (next() % 3 == 0) word += CONSONANTS[next() % 20];
+            }
+            word += ENDINGS[next() % 24];
+            auto it = std::lower_bound(seen.begin(), seen.end(), word);
+            if (it != seen.end() && *it == word) continue;
+            seen.insert(it, word);
+            words_.push_back(word);
+        }
+    }
+
+    void build_cdf() {
+        cdf_.resize(words_.size());
+        double sum = 0.0;
+        for (size_t r = 0; r < words_.size(); ++r) {
+            sum += 1.0 / std::pow(static_cast<double>(r + 1), params_.zipf_s);
+            cdf_[r] = sum;
+        }
+        for (auto& c : cdf_) c /= sum;
+    }
+
+    // первая буква заглавная (кириллица в UTF-8 - два байта)
+    static std::string capitalize(const std::string& word) {
+        std::string w = word;
+        unsigned char c1 = static_cast<unsigned char>(w[0]);
+        if (w.size() >= 2 && c1 == 0xD0) {
+            unsigned char c2 = static_cast<unsigned char>(w[1]);
+            if (c2 >= 0xB0 && c2 <= 0xBF) w[1] = static_cast<char>(c2 - 0x20);
+        } else if (w.size() >= 2 && c1 == 0xD1) {
+            unsigned char c2 = static_cast<unsigned char>(w[1]);
+            if (c2 >= 0x80 && c2 <= 0x8F) {
+                w[0] = static_cast<char>(0xD0);
+                w[1] = static_cast<char>(c2 + 0x20);
+            }
+        } else if (c1 >= 'a' && c1 <= 'z') {
+            w[0] = static_cast<char>(c1 - 32);
+        }
+        return w;
+    }
+
+    CorpusParams params_;
+    std::mt19937_64 rng_;
+    std::vector<std::string> words_;
+    std::vector<double> cdf_;
+};
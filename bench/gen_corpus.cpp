@@ -0,0 +1,77 @@
+// g++ -std=c++17 -O2 gen_corpus.cpp -o gen_corpus.exe
+// ./gen_corpus.exe [--out synthetic] [--docs 2000] [--vocabulary 50000] [--queries 1000] [--seed 42] [--zipf 1.0]
+
+// синтетический корпус в раскладке репозитория, чтобы прогнать конвейер без дампа базы:
+//   <out>/preprocessor/docs/<doc_id>.txt - документы для tokenizer.exe
+//   <out>/searcher/queries.txt           - запросы (стемы) для loadgen.exe и searcher.exe --bench
+// Запросы: одиночный термин, and, or, and not - в долях 40/30/15/15.
+
+#include "pipeline_sources.h"
+#include "corpus_gen.h"
+
+std::string query_term(SyntheticCorpus& corpus) {
+    while (true) {
+        std::string term = stemmer_src::stem(corpus.query_word());
+        if (stemmer_src::utf8_char_count(term) >= 2) return term;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    CorpusParams params;
+    std::string out_dir = "synthetic";
+    size_t query_count = 1000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) {
+            out_dir = argv[++i];
+        } else if (arg == "--docs" && i + 1 < argc) {
+            params.docs = static_cast<size_t>(std::stoull(argv[++i]));
+        } else if (arg == "--vocabulary" && i + 1 < argc) {
+            params.vocabulary = static_cast<size_t>(std::stoull(argv[++i]));
+        } else if (arg == "--queries" && i + 1 < argc) {
+            query_count = static_cast<size_t>(std::stoull(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            params.seed = std::stoull(argv[++i]);
+        } else if (arg == "--zipf" && i + 1 < argc) {
+            params.zipf_s = std::stod(argv[++i]);
+        } else {
+            std::cerr << "Неизвестный параметр: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    SyntheticCorpus corpus(params);
+    std::string docs_dir = out_dir + "/preprocessor/docs";
+    std::filesystem::create_directories(docs_dir);
+    std::filesystem::create_directories(out_dir + "/searcher");
+
+    size_t total_bytes = 0;
+    for (size_t id = 1; id <= params.docs; ++id) {
+        std::string text = corpus.document();
+        std::ofstream out(docs_dir + "/" + std::to_string(id) + ".txt", std::ios::binary);
+        out << text;
+        if (!out) {
+            std::cerr << "Ошибка записи в " << docs_dir << "\n";
+            return 1;
+        }
+        total_bytes += text.size();
+    }
+
+    std::ofstream queries(out_dir + "/searcher/queries.txt", std::ios::binary);
+    for (size_t q = 0; q < query_count; ++q) {
+        uint64_t shape = corpus.next() % 100;
+        std::string line = query_term(corpus);
+        if (shape >= 85) {
+            line += " and not " + query_term(corpus);
+        } else if (shape >= 70) {
+            line += " or " + query_term(corpus);
+        } else if (shape >= 40) {
+            line += " and " + query_term(corpus);
+        }
+        queries << line << "\n";
+    }
+
+    std::cout << "Документов: " << params.docs << ", " << total_bytes / 1024 << " КБ, запросов: " << query_count
+              << " -> " << out_dir << "\n";
+    return 0;
+}
@@ -0,0 +1,323 @@
+// g++ -std=c++17 -O2 microbench.cpp -o microbench.exe
+// ./microbench.exe [--docs 2000] [--seed 42] [--repeat 5] [--only имя] [--out results.json]
+
+// микробенчмарки функций конвейера и поиска на синтетическом корпусе (corpus_gen.h):
+// работает без дампа корпуса и без PostgreSQL. Результат - JSON в stdout (и в --out):
+// для каждого замера объём работы, минимальное и медианное время из --repeat прогонов,
+// скорость и контрольная сумма. При одинаковых --docs и --seed работа одинакова, поэтому
+// результаты разных машин и версий кода можно сравнивать напрямую.
+
+#include "pipeline_sources.h"
+#include "../searcher/postings.h"
+#include "corpus_gen.h"
+
+#include <unordered_map>
+
+struct BenchResult {
+    std::string name;
+    uint64_t items = 0;      // обработанных единиц (документов, слов, элементов списков)
+    uint64_t bytes = 0;      // обработанных байт, если применимо
+    std::vector<double> seconds;
+    uint64_t checksum = 0;
+};
+
+// body возвращает контрольную сумму - так компилятор не выбросит работу
+template <typename Body>
+BenchResult run_bench(const std::string& name, size_t repeat, uint64_t items, uint64_t bytes, Body body) {
+    BenchResult result;
+    result.name = name;
+    result.items = items;
+    result.bytes = bytes;
+    result.checksum = body();  // прогрев
+    for (size_t r = 0; r < repeat; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t sum = body();
+        result.seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        if (sum != result.checksum) std::cerr << name << ": контрольная сумма отличается между прогонами\n";
+    }
+    std::sort(result.seconds.begin(), result.seconds.end());
+    std::cerr << name << ": " << result.seconds[result.seconds.size() / 2] * 1000 << " мс\n";
+    return result;
+}
+
+std::vector<std::string> read_lines(const std::string& path) {
+    std::vector<std::string> lines;
+    std::ifstream in(path, std::ios::binary);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) lines.push_back(line);
+    }
+    return lines;
+}
+
+uint64_t hash_string(const std::string& s) {
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : s) h = (h ^ c) * 1099511628211ull;
+    return h;
+}
+
+std::string to_json(const std::vector<BenchResult>& results, const CorpusParams& params, size_t repeat) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(6);
+    out << "{\n  \"params\": {\"seed\": " << params.seed << ", \"docs\": " << params.docs
+        << ", \"vocabulary\": " << params.vocabulary << ", \"zipf_s\": " << params.zipf_s
+        << ", \"repeat\": " << repeat << "},\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        double median = r.seconds[r.seconds.size() / 2];
+        out << "    {\"name\": \"" << r.name << "\", \"items\": " << r.items << ", \"bytes\": " << r.bytes
+            << ", \"min_sec\": " << r.seconds.front() << ", \"median_sec\": " << median
+            << ", \"items_per_sec\": " << (median > 0 ? r.items / median : 0.0)
+            << ", \"bytes_per_sec\": " << (median > 0 ? r.bytes / median : 0.0)
+            << ", \"ns_per_item\": " << (r.items > 0 ? median * 1e9 / r.items : 0.0)
+            << ", \"checksum\": " << r.checksum << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return out.str();
+}
+
+int main(int argc, char* argv[]) {
+    CorpusParams params;
+    size_t repeat = 5;
+    std::string only;
+    std::string out_path;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--docs" && i + 1 < argc) {
+            params.docs = static_cast<size_t>(std::stoull(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            params.seed = std::stoull(argv[++i]);
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max<size_t>(1, static_cast<size_t>(std::stoull(argv[++i])));
+        } else if (arg == "--only" && i + 1 < argc) {
+            only = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            out_path = argv[++i];
+        } else {
+            std::cerr << "Неизвестный параметр: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    // входные данные: документы, слова, токены, стемы
+    SyntheticCorpus corpus(params);
+    std::vector<std::string> docs;
+    uint64_t doc_bytes = 0;
+    for (size_t d = 0; d < params.docs; ++d) {
+        docs.push_back(corpus.document());
+        doc_bytes += docs.back().size();
+    }
+    std::vector<std::string> abbrevs = read_lines("../preprocessor/known_abbrevs.txt");
+    std::vector<std::string> stop_words = read_lines("../preprocessor/stop_words.txt");
+    if (stop_words.empty()) std::cerr << "../preprocessor/stop_words.txt не найден, стоп-слов нет\n";
+
+    std::vector<std::string> words;
+    uint64_t word_bytes = 0;
+    std::vector<std::vector<std::string>> doc_tokens;
+    std::vector<std::string> tokens;
+    uint64_t token_bytes = 0;
+    for (const auto& text : docs) {
+        std::istringstream iss(text);
+        std::string w;
+        while (iss >> w) {
+            word_bytes += w.size();
+            words.push_back(std::move(w));
+        }
+        doc_tokens.push_back(tokenizer_src::tokenize(text, abbrevs));
+        for (const auto& t : doc_tokens.back()) token_bytes += t.size();
+        tokens.insert(tokens.end(), doc_tokens.back().begin(), doc_tokens.back().end());
+    }
+
+    // стемы документов и обратный индекс (как у indexer.exe, без файлов)
+    std::vector<std::vector<std::string>> doc_stems;
+    std::unordered_map<std::string, std::vector<int>> inverted;
+    for (size_t d = 0; d < doc_tokens.size(); ++d) {
+        std::vector<std::string> stems;
+        for (const auto& t : doc_tokens[d]) {
+            if (stemmer_src::is_stop_word(t, stop_words)) continue;
+            std::string s = stemmer_src::stem(t);
+            if (stemmer_src::utf8_char_count(s) < 2) continue;
+            stems.push_back(s);
+        }
+        for (const auto& s : indexer_src::remove_term_duplicates(stems)) {
+            inverted[s].push_back(static_cast<int>(d + 1));
+        }
+        doc_stems.push_back(std::move(stems));
+    }
+    std::vector<std::string> terms;
+    for (const auto& e : inverted) terms.push_back(e.first);
+    std::sort(terms.begin(), terms.end());
+    std::vector<std::vector<int>> postings;
+    for (const auto& t : terms) postings.push_back(inverted[t]);
+
+    std::vector<BenchResult> results;
+    auto want = [&only](const std::string& name) { return only.empty() || name.find(only) != std::string::npos; };
+
+    if (want("tokenize")) {
+        results.push_back(run_bench("tokenize", repeat, docs.size(), doc_bytes, [&] {
+            uint64_t sum = 0;
+            for (const auto& text : docs) sum += tokenizer_src::tokenize(text, abbrevs).size();
+            return sum;
+        }));
+    }
+    if (want("to_lower_utf8")) {
+        results.push_back(run_bench("to_lower_utf8", repeat, words.size(), word_bytes, [&] {
+            uint64_t sum = 0;
+            for (const auto& w : words) sum += tokenizer_src::to_lower_utf8(w).size();
+            return sum;
+        }));
+    }
+    if (want("stem")) {
+        results.push_back(run_bench("stem", repeat, tokens.size(), token_bytes, [&] {
+            uint64_t sum = 0;
+            for (const auto& t : tokens) sum += stemmer_src::stem(t).size();
+            return sum;
+        }));
+    }
+    if (want("is_stop_word")) {
+        results.push_back(run_bench("is_stop_word", repeat, tokens.size(), token_bytes, [&] {
+            uint64_t sum = 0;
+            for (const auto& t : tokens) sum += stemmer_src::is_stop_word(t, stop_words);
+            return sum;
+        }));
+    }
+    if (want("hash_table_insert")) {
+        results.push_back(run_bench("hash_table_insert", repeat, terms.size(), 0, [&] {
+            indexer_src::SimpleHashTable table(1048576);
+            uint64_t sum = 0;
+            for (size_t i = 0; i < terms.size(); ++i) sum += table.insert(terms[i], i);
+            return sum;
+        }));
+    }
+    if (want("hash_table_find")) {
+        indexer_src::SimpleHashTable table(1048576);
+        for (size_t i = 0; i < terms.size(); ++i) table.insert(terms[i], i);
+        uint64_t lookups = 0;
+        for (const auto& s : doc_stems) lookups += s.size();
+        results.push_back(run_bench("hash_table_find", repeat, lookups, 0, [&] {
+            uint64_t sum = 0;
+            for (const auto& stems : doc_stems) {
+                for (const auto& s : stems) {
+                    size_t* v = table.find(s);
+                    sum += v ? *v : 0;
+                }
+            }
+            return sum;
+        }));
+    }
+    if (want("remove_term_duplicates")) {
+        uint64_t count = 0;
+        for (const auto& s : doc_stems) count += s.size();
+        results.push_back(run_bench("remove_term_duplicates", repeat, count, 0, [&] {
+            uint64_t sum = 0;
+            for (const auto& stems : doc_stems) sum += indexer_src::remove_term_duplicates(stems).size();
+            return sum;
+        }));
+    }
+    if (want("sort_terms_lex")) {
+        // сортировка выбором квадратична: берётся не больше 4000 терминов в порядке хеша
+        std::vector<std::string> sample_terms(terms);
+        std::sort(sample_terms.begin(), sample_terms.end(), [](const std::string& a, const std::string& b) {
+            return hash_string(a) < hash_string(b);
+        });
+        if (sample_terms.size() > 4000) sample_terms.resize(4000);
+        results.push_back(run_bench("sort_terms_lex", repeat, sample_terms.size(), 0, [&] {
+            std::vector<std::string> t = sample_terms;
+            std::vector<std::vector<int>> p(t.size());
+            indexer_src::sort_terms_lex(t, p);
+            return hash_string(t.front()) ^ hash_string(t.back());
+        }));
+    }
+    if (want("sort_postings")) {
+        // posting листы в порядке, обратном возрастанию, - худший случай сортировки вставками
+        std::vector<std::vector<int>> reversed;
+        uint64_t count = 0;
+        for (const auto& p : postings) {
+            if (p.size() < 2) continue;
+            reversed.emplace_back(p.rbegin(), p.rend());
+            count += p.size();
+        }
+        results.push_back(run_bench("sort_postings_with_positions", repeat, count, 0, [&] {
+            uint64_t sum = 0;
+            for (const auto& list : reversed) {
+                std::vector<int> l = list;
+                std::vector<std::string> positions(l.size());
+                indexer_src::sort_postings_with_positions(l, positions);
+                sum += static_cast<uint64_t>(l.front());
+            }
+            return sum;
+        }));
+    }
+    if (want("load_index")) {
+        std::string path = (std::filesystem::temp_directory_path() / "microbench_index.txt").string();
+        indexer_src::write_index(path, terms, postings);
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(path, ec);
+        results.push_back(run_bench("load_index", repeat, terms.size(), ec ? 0 : size, [&] {
+            TermIndex index;
+            load_index(path, index);
+            uint64_t sum = 0;
+            for (const auto& e : index.postings) sum += e.doc_count;
+            return sum;
+        }));
+        std::filesystem::remove(path, ec);
+    }
+    if (want("term_lookup")) {
+        // поиск в словаре: основы слов запросов по Ципфу, часть из них в словаре отсутствует
+        TermDictionary dict;
+        for (const auto& t : terms) dict.add(t);
+        dict.finish();
+        std::vector<std::string> lookups;
+        for (size_t q = 0; q < 20000; ++q) lookups.push_back(stemmer_src::stem(corpus.query_word()));
+        results.push_back(run_bench("term_lookup", repeat, lookups.size(), dict.memory_bytes(), [&] {
+            uint64_t sum = 0;
+            for (const auto& t : lookups) sum += static_cast<uint64_t>(dict.find(t) + 1);
+            return sum;
+        }));
+    }
+
+    // пары posting листов для операций над множествами: термины запросов по Ципфу
+    std::vector<std::pair<const std::vector<int>*, const std::vector<int>*>> pairs;
+    uint64_t pair_items = 0;
+    for (size_t q = 0; q < 500 && !terms.empty(); ++q) {
+        auto pick = [&]() -> const std::vector<int>* {
+            for (size_t attempt = 0; attempt < 100; ++attempt) {
+                auto it = inverted.find(stemmer_src::stem(corpus.query_word()));
+                if (it != inverted.end()) return &it->second;
+            }
+            return &postings[0];
+        };
+        pairs.emplace_back(pick(), pick());
+        pair_items += pairs.back().first->size() + pairs.back().second->size();
+    }
+    if (want("intersect_lists")) {
+        results.push_back(run_bench("intersect_lists", repeat, pair_items, 0, [&] {
+            uint64_t sum = 0;
+            for (const auto& p : pairs) sum += intersect_lists(*p.first, *p.second).size();
+            return sum;
+        }));
+    }
+    if (want("union_lists")) {
+        results.push_back(run_bench("union_lists", repeat, pair_items, 0, [&] {
+            uint64_t sum = 0;
+            for (const auto& p : pairs) sum += union_lists(*p.first, *p.second).size();
+            return sum;
+        }));
+    }
+    if (want("difference_lists")) {
+        results.push_back(run_bench("difference_lists", repeat, pair_items, 0, [&] {
+            uint64_t sum = 0;
+            for (const auto& p : pairs) sum += difference_lists(*p.first, *p.second).size();
+            return sum;
+        }));
+    }
+
+    std::string json = to_json(results, params, repeat);
+    std::cout << json;
+    if (!out_path.empty()) {
+        std::ofstream out(out_path, std::ios::binary);
+        out << json;
+    }
+    return 0;
+}
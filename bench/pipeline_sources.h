@@ -0,0 +1,51 @@
+// Функции tokenizer.cpp, stemmer.cpp и indexer.cpp для бенчмарков. Программы конвейера -
+// одиночные файлы с main, поэтому исходники включаются целиком, каждый в своё пространство
+// имён (main переименовывается): замеряется ровно тот код, который работает в конвейере.
+
+#pragma once
+
+// заголовки, которые включают исходники, подключаются заранее и вне пространств имён
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "../common/metrics.h"
+#include "../common/docpack.h"
+#include "../common/build_manifest.h"
+#include "../common/file_batch.h"
+#include "../searcher/segments.h"
+#include "../searcher/suggest.h"
+#include "../searcher/doc_reorder.h"
+#include "../searcher/near_dup.h"
+#include "../searcher/docstore.h"
+#include "../searcher/attributes.h"
+#include "../searcher/shards.h"
+
+namespace tokenizer_src {
+#define main tokenizer_main
+#include "../preprocessor/tokenizer.cpp"
+#undef main
+}
+
+namespace stemmer_src {
+#define main stemmer_main
+#include "../preprocessor/stemmer.cpp"
+#undef main
+}
+
+namespace indexer_src {
+#define main indexer_main
+#include "../searcher/indexer.cpp"
+#undef main
+}
@@ -0,0 +1,6 @@
+#!/bin/sh
+# сборка и запуск микробенчмарков на Linux: ./run_bench.sh [--docs 2000] [--seed 42] [--out results.json]
+set -e
+cd "$(dirname "$0")"
+g++ -std=c++17 -O2 microbench.cpp -o microbench.exe
+./microbench.exe "$@"
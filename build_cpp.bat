@@ -1,37 +1,54 @@
 @echo off
 setlocal
 
-echo [1/4] Сборка tokenizer.exe...
-g++ -std=c++17 -O2 preprocessor/tokenizer.cpp -o preprocessor/tokenizer.exe
+echo [1/6] Сборка tokenizer.exe...
+g++ -std=c++17 -O2 preprocessor/tokenizer.cpp -lpsapi -o preprocessor/tokenizer.exe
 if errorlevel 1 (
     echo Ошибка при сборке tokenizer.exe
     exit /b 1
 )
 
-echo [2/4] Сборка stemmer.exe...
-g++ -std=c++17 -O2 preprocessor/stemmer.cpp -o preprocessor/stemmer.exe
+echo [2/6] Сборка stemmer.exe...
+g++ -std=c++17 -O2 preprocessor/stemmer.cpp -lpsapi -o preprocessor/stemmer.exe
 if errorlevel 1 (
     echo Ошибка при сборке stemmer.exe
     exit /b 1
 )
 
-echo [3/4] Сборка indexer.exe...
-g++ -std=c++17 -O2 searcher/indexer.cpp -o searcher/indexer.exe
+echo [3/6] Сборка indexer.exe...
+g++ -std=c++17 -O2 searcher/indexer.cpp -lpsapi -o searcher/indexer.exe
 if errorlevel 1 (
     echo Ошибка при сборке indexer.exe
     exit /b 1
 )
 
-echo [4/4] Сборка searcher.exe (требуется PostgreSQL 16)...
+echo [4/6] Сборка searcher.exe (требуется PostgreSQL 16)...
 g++ -std=c++17 -O2 searcher/searcher.cpp ^
     -I"C:\Program Files\PostgreSQL\16\include" ^
     -L"C:\Program Files\PostgreSQL\16\lib" ^
-    -lpq -o searcher/searcher.exe
+    -lpq -lws2_32 -o searcher/searcher.exe
 if errorlevel 1 (
     echo Ошибка при сборке searcher.exe.
     echo Убедитесь, что PostgreSQL 16 установлен в "C:\Program Files\PostgreSQL\16".
     exit /b 1
 )
 
+echo [5/6] Сборка exporter.exe (требуется PostgreSQL 16)...
+g++ -std=c++17 -O2 preprocessor/exporter.cpp ^
+    -I"C:\Program Files\PostgreSQL\16\include" ^
+    -L"C:\Program Files\PostgreSQL\16\lib" ^
+    -lpq -lpsapi -o preprocessor/exporter.exe
+if errorlevel 1 (
+    echo Ошибка при сборке exporter.exe
+    exit /b 1
+)
+
+echo [6/6] Сборка loadgen.exe...
+g++ -std=c++17 -O2 searcher/loadgen.cpp -lws2_32 -o searcher/loadgen.exe
+if errorlevel 1 (
+    echo Ошибка при сборке loadgen.exe
+    exit /b 1
+)
+
 echo.
 echo Все C++ программы успешно скомпилированы.
\ No newline at end of file
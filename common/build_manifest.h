@@ -0,0 +1,173 @@
+// Манифест инкрементальной предобработки (tokenizer.exe, stemmer.exe).
+//
+// Для каждого doc_id хранятся размер входа, хэш его содержимого и время источника
+// (fetch_timestamp из базы или время изменения входного файла). При следующем запуске стадия
+// обрабатывает только новые и изменённые документы: совпали размер и время - вход даже не читается,
+// иначе сравнивается хэш (повторно скачанная, но не изменившаяся статья тоже пропускается).
+//
+// <каталог вывода>/manifest.txt, переписывается целиком через временный файл:
+//   settings <хэш настроек стадии>
+//   <doc_id> <размер> <хэш> <время источника>
+// Настройки - версия правил и словари стадии (сокращения, стоп-слова): если они поменялись,
+// старый манифест не используется и обрабатывается всё.
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+
+// FNV-1a, 64 бита
+inline uint64_t content_hash(const std::string& data, uint64_t hash = 1469598103934665603ull) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline long long file_time_value(const std::filesystem::path& path) {
+    return static_cast<long long>(std::filesystem::last_write_time(path).time_since_epoch().count());
+}
+
+class BuildManifest {
+public:
+    enum State { NEW, CHANGED, UNCHANGED };
+
+    // false - манифеста нет или он построен с другими настройками
+    bool load(const std::string& path, uint64_t settings) {
+        settings_ = settings;
+        entries_.clear();
+        std::ifstream in(path);
+        std::string word;
+        uint64_t stored = 0;
+        if (!(in >> word >> stored) || word != "settings" || stored != settings) return false;
+        int doc_id;
+        Entry e;
+        while (in >> doc_id >> e.size >> e.hash >> e.source_time) {
+            entries_[doc_id] = e;
+        }
+        return true;
+    }
+
+    // --full: прежние записи не используются, манифест заполняется заново с текущими настройками
+    void reset(uint64_t settings) {
+        settings_ = settings;
+        entries_.clear();
+    }
+
+    // вход не менялся по размеру и времени источника (время 0 - неизвестно, не доверяем)
+    bool same_source(int doc_id, uint64_t size, long long source_time) {
+        auto it = entries_.find(doc_id);
+        if (it == entries_.end() || source_time == 0) return false;
+        if (it->second.size != size || it->second.source_time != source_time) return false;
+        it->second.seen = true;
+        return true;
+    }
+
+    // вход не удалось прочитать: прежний результат и запись остаются, при следующем запуске документ
+    // перечитывается (время источника в записи старое)
+    void keep(int doc_id) {
+        auto it = entries_.find(doc_id);
+        if (it != entries_.end()) it->second.seen = true;
+    }
+
+    // сравнивает содержимое с записанным и запоминает новое состояние
+    State update(int doc_id, uint64_t size, uint64_t hash, long long source_time) {
+        auto it = entries_.find(doc_id);
+        State state = NEW;
+        if (it != entries_.end()) {
+            state = it->second.size == size && it->second.hash == hash ? UNCHANGED : CHANGED;
+        }
+        Entry& e = entries_[doc_id];
+        e.size = size;
+        e.hash = hash;
+        e.source_time = source_time;
+        e.seen = true;
+        return state;
+    }
+
+    // документы из манифеста, которых не было во входе этого запуска; удаляются из манифеста
+    std::vector<int> take_unseen() {
+        std::vector<int> gone;
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            if (it->second.seen) {
+                ++it;
+            } else {
+                gone.push_back(it->first);
+                it = entries_.erase(it);
+            }
+        }
+        std::sort(gone.begin(), gone.end());
+        return gone;
+    }
+
+    bool save(const std::string& path) const {
+        std::vector<int> ids;
+        ids.reserve(entries_.size());
+        for (const auto& e : entries_) ids.push_back(e.first);
+        std::sort(ids.begin(), ids.end());
+
+        std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream out(tmp_path);
+            out << "settings " << settings_ << "\n";
+            for (int id : ids) {
+                const Entry& e = entries_.at(id);
+                out << id << " " << e.size << " " << e.hash << " " << e.source_time << "\n";
+            }
+            if (!out) return false;
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp_path, path, ec);
+        return !ec;
+    }
+
+private:
+    struct Entry {
+        uint64_t size = 0;
+        uint64_t hash = 0;
+        long long source_time = 0;
+        bool seen = false;
+    };
+
+    uint64_t settings_ = 0;
+    std::unordered_map<int, Entry> entries_;
+};
+
+// удаляет из каталога вывода <doc_id><ext> документов, которых нет во входе (inputs отсортирован),
+// и возвращает их число. Сверка идёт с каталогом, а не с манифестом: при --full или смене настроек
+// старый манифест не загружается, а прежние выходы удалённых документов остаются
+inline size_t remove_stale_outputs(const std::string& dir, const std::string& ext, const std::vector<int>& inputs) {
+    std::vector<std::filesystem::path> stale;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.path().extension() != ext) continue;
+        int doc_id = std::stoi(entry.path().stem().string());
+        if (!std::binary_search(inputs.begin(), inputs.end(), doc_id)) stale.push_back(entry.path());
+    }
+    for (const auto& path : stale) {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+    return stale.size();
+}
+
+// счётчики для отчёта стадии
+struct ManifestReport {
+    size_t added = 0;
+    size_t changed = 0;
+    size_t skipped = 0;
+    size_t removed = 0;
+
+    std::string summary() const {
+        std::ostringstream out;
+        out << "новых: " << added << ", изменённых: " << changed << ", без изменений (пропущено): " << skipped
+            << ", удалённых: " << removed;
+        return out.str();
+    }
+};
@@ -0,0 +1,128 @@
+// Упакованный поток документов docs.pack: exporter.exe пишет, tokenizer.exe читает.
+// Вместо файла на документ в docs/ - одна последовательная запись и одно последовательное чтение.
+//
+// Формат (числа little-endian):
+//   "DPK2"
+//   записи: uint32 doc_id, uint32 длина, int64 время источника (fetch_timestamp, 0 - неизвестно), текст UTF-8
+//   конец: запись с doc_id = 0 и длиной 0; без неё поток считается оборванным
+// Поток можно передавать через канал: exporter.exe config.yaml --out - | tokenizer.exe --input -
+// Читается и прежний "DPK1" - те же записи без времени источника.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <istream>
+#include <ostream>
+#include <string>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+const char DOCPACK_MAGIC[4] = {'D', 'P', 'K', '2'};
+const char DOCPACK_MAGIC_V1[4] = {'D', 'P', 'K', '1'};
+const uint32_t DOCPACK_MAX_DOC = 256u * 1024 * 1024;
+
+// stdin/stdout без преобразования \n в \r\n (на Windows)
+inline void set_binary_mode(FILE* f) {
+#ifdef _WIN32
+    _setmode(_fileno(f), _O_BINARY);
+#else
+    (void)f;
+#endif
+}
+
+inline void write_le32(std::ostream& out, uint32_t v) {
+    char b[4] = {static_cast<char>(v), static_cast<char>(v >> 8), static_cast<char>(v >> 16),
+                 static_cast<char>(v >> 24)};
+    out.write(b, 4);
+}
+
+inline bool read_le32(std::istream& in, uint32_t& v) {
+    unsigned char b[4];
+    if (!in.read(reinterpret_cast<char*>(b), 4)) return false;
+    v = b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<uint32_t>(b[3]) << 24);
+    return true;
+}
+
+inline void write_le64(std::ostream& out, int64_t v) {
+    write_le32(out, static_cast<uint32_t>(v));
+    write_le32(out, static_cast<uint32_t>(static_cast<uint64_t>(v) >> 32));
+}
+
+inline bool read_le64(std::istream& in, int64_t& v) {
+    uint32_t lo = 0, hi = 0;
+    if (!read_le32(in, lo) || !read_le32(in, hi)) return false;
+    v = static_cast<int64_t>((static_cast<uint64_t>(hi) << 32) | lo);
+    return true;
+}
+
+class DocPackWriter {
+public:
+    explicit DocPackWriter(std::ostream& out) : out_(out) { out_.write(DOCPACK_MAGIC, 4); }
+
+    void add(uint32_t doc_id, const std::string& text, int64_t source_time = 0) {
+        write_le32(out_, doc_id);
+        write_le32(out_, static_cast<uint32_t>(text.size()));
+        write_le64(out_, source_time);
+        out_.write(text.data(), static_cast<std::streamsize>(text.size()));
+        ++count_;
+    }
+
+    // запись конца потока; false - ошибка записи
+    bool finish() {
+        write_le32(out_, 0);
+        write_le32(out_, 0);
+        write_le64(out_, 0);
+        out_.flush();
+        return static_cast<bool>(out_);
+    }
+
+    size_t count() const { return count_; }
+
+private:
+    std::ostream& out_;
+    size_t count_ = 0;
+};
+
+class DocPackReader {
+public:
+    explicit DocPackReader(std::istream& in) : in_(in) {
+        char magic[4];
+        if (!in_.read(magic, 4)) return;
+        valid_ = std::equal(magic, magic + 4, DOCPACK_MAGIC);
+        with_time_ = valid_;
+        if (!valid_) valid_ = std::equal(magic, magic + 4, DOCPACK_MAGIC_V1);
+    }
+
+    bool valid() const { return valid_; }
+
+    // следующий документ; false - конец потока или ошибка (см. complete())
+    bool next(uint32_t& doc_id, std::string& text, int64_t* source_time = nullptr) {
+        if (!valid_ || complete_) return false;
+        uint32_t size = 0;
+        int64_t time = 0;
+        if (!read_le32(in_, doc_id) || !read_le32(in_, size)) return false;
+        if (with_time_ && !read_le64(in_, time)) return false;
+        if (source_time) *source_time = time;
+        if (doc_id == 0 && size == 0) {
+            complete_ = true;
+            return false;
+        }
+        if (size > DOCPACK_MAX_DOC) return false;
+        text.resize(size);
+        return size == 0 || static_cast<bool>(in_.read(&text[0], size));
+    }
+
+    // дочитан ли поток до записи конца
+    bool complete() const { return complete_; }
+
+private:
+    std::istream& in_;
+    bool valid_ = false;
+    bool with_time_ = false;
+    bool complete_ = false;
+};
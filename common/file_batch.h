@@ -0,0 +1,415 @@
+// Пакетное чтение множества небольших файлов (docs/*.txt, tokens/*.tokens, stems/*.stems).
+//
+// Стадии конвейера читают десятки тысяч файлов по несколько килобайт, и каждый open/read/close
+// блокирует цикл обработки. FileBatchReader держит в полёте окно из window файлов: пока цикл
+// обрабатывает один документ, следующие уже читаются. Файлы отдаются в порядке списка.
+//
+// Linux: открытие, чтение и закрытие идут через io_uring пакетами (один io_uring_enter на пакет,
+// без liburing - кольца отображаются напрямую). Если io_uring недоступен (старое ядро, seccomp
+// в контейнере), а также на Windows - пул потоков, читающих файлы обычным образом.
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const size_t FILE_BATCH_WINDOW = 64;
+const size_t FILE_BATCH_THREADS = 4;
+
+inline bool read_whole_file(const std::string& path, std::string& data) {
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    if (!f) return false;
+    std::streamoff size = f.tellg();
+    if (size < 0) return false;
+    data.resize(static_cast<size_t>(size));
+    f.seekg(0);
+    return size == 0 || static_cast<bool>(f.read(&data[0], size));
+}
+
+#ifdef __linux__
+
+// минимальная обёртка над io_uring: одно кольцо отправки и одно кольцо завершений
+class IoUring {
+public:
+    explicit IoUring(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) return;
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+            close_ring();
+            return;
+        }
+
+        ring_size_ = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                              params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        ring_ = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (ring_ == MAP_FAILED || sqes == MAP_FAILED) {
+            if (ring_ != MAP_FAILED) munmap(ring_, ring_size_);
+            if (sqes != MAP_FAILED) munmap(sqes, sqes_size_);
+            ring_ = nullptr;
+            close_ring();
+            return;
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        char* base = static_cast<char*>(ring_);
+        sq_head_ = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+        sq_entries_ = params.sq_entries;
+        cq_head_ = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+
+        // проверка, что нужные операции поддерживаются ядром (openat/close - с 5.6)
+        if (!supports(IORING_OP_OPENAT) || !supports(IORING_OP_READ) || !supports(IORING_OP_CLOSE)) {
+            munmap(sqes_, sqes_size_);
+            munmap(ring_, ring_size_);
+            ring_ = nullptr;
+            close_ring();
+        }
+    }
+
+    ~IoUring() {
+        if (ring_) {
+            munmap(sqes_, sqes_size_);
+            munmap(ring_, ring_size_);
+        }
+        close_ring();
+    }
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    bool ok() const { return fd_ >= 0; }
+
+    // свободная запись в кольце отправки или nullptr, если кольцо заполнено
+    io_uring_sqe* get_sqe() {
+        unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (local_tail_ - head >= sq_entries_) return nullptr;
+        unsigned idx = local_tail_ & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[idx] = idx;
+        ++local_tail_;
+        return sqe;
+    }
+
+    // отправляет накопленные записи и, если wait, ждёт хотя бы одного завершения
+    bool submit(bool wait) {
+        unsigned to_submit = local_tail_ - *sq_tail_;
+        __atomic_store_n(sq_tail_, local_tail_, __ATOMIC_RELEASE);
+        if (to_submit == 0 && !wait) return true;
+        unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+        while (true) {
+            long r = syscall(__NR_io_uring_enter, fd_, to_submit, wait ? 1 : 0, flags, nullptr, 0);
+            if (r >= 0) return true;
+            if (errno != EINTR) return false;
+        }
+    }
+
+    // следующее завершение, если есть
+    bool pop_cqe(uint64_t& user_data, int& res) {
+        unsigned head = *cq_head_;
+        if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) return false;
+        const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        user_data = cqe.user_data;
+        res = cqe.res;
+        __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    bool supports(int op) {
+        const unsigned count = 64;
+        std::vector<char> buf(sizeof(io_uring_probe) + count * sizeof(io_uring_probe_op), 0);
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buf.data());
+        if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, count) < 0) return false;
+        return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    void close_ring() {
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
+    int fd_ = -1;
+    void* ring_ = nullptr;
+    size_t ring_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned local_tail_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+#endif
+
+class FileBatchReader {
+public:
+    // use_io_uring = false - всегда пул потоков (--no-io-uring у стадий)
+    FileBatchReader(std::vector<std::string> paths, bool use_io_uring = true, size_t window = FILE_BATCH_WINDOW,
+                    size_t threads = FILE_BATCH_THREADS)
+        : paths_(std::move(paths)), window_(std::max<size_t>(window, 1)), slots_(window_) {
+#ifdef __linux__
+        if (use_io_uring) {
+            ring_ = std::make_unique<IoUring>(static_cast<unsigned>(window_ * 2));
+            if (ring_->ok()) return;
+            ring_.reset();
+        }
+#else
+        (void)use_io_uring;
+#endif
+        for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i) {
+            workers_.emplace_back([this] { run_worker(); });
+        }
+    }
+
+    ~FileBatchReader() {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            stop_ = true;
+        }
+        wake_workers_.notify_all();
+        for (auto& t : workers_) t.join();
+#ifdef __linux__
+        // ядро ещё может писать в буферы незавершённых операций
+        if (ring_) drain_ring();
+#endif
+    }
+
+    FileBatchReader(const FileBatchReader&) = delete;
+    FileBatchReader& operator=(const FileBatchReader&) = delete;
+
+    const char* backend() const {
+#ifdef __linux__
+        if (ring_) return "io_uring";
+#endif
+        return "threads";
+    }
+
+    // следующий файл по порядку списка; false - файлы закончились. ok = false - файл не прочитан
+    bool next(size_t& index, std::string& data, bool& ok) {
+        if (delivered_ >= paths_.size()) return false;
+        index = delivered_;
+        Slot& slot = slots_[index % window_];
+#ifdef __linux__
+        if (ring_) {
+            fill_ring();
+            while (!slot.done) {
+                if (!ring_->submit(true)) throw std::runtime_error("io_uring_enter: " + std::string(strerror(errno)));
+                reap_ring();
+                fill_ring();
+            }
+        } else
+#endif
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+            done_.wait(guard, [&] { return slot.done; });
+        }
+        data = std::move(slot.data);
+        ok = slot.ok;
+        slot = Slot();
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            ++delivered_;
+        }
+        wake_workers_.notify_one();  // освободилось одно место в окне
+        return true;
+    }
+
+    // файлов, запрошенных, но ещё не отданных циклу обработки
+    size_t in_flight() {
+        std::lock_guard<std::mutex> guard(lock_);
+        return started_ - delivered_;
+    }
+
+private:
+    struct Slot {
+        std::string data;
+        bool done = false;
+        bool ok = false;
+#ifdef __linux__
+        int fd = -1;
+        size_t size = 0;   // прочитано байт
+#endif
+    };
+
+    void run_worker() {
+        while (true) {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> guard(lock_);
+                wake_workers_.wait(guard, [&] {
+                    return stop_ || (started_ < paths_.size() && started_ < delivered_ + window_);
+                });
+                if (stop_) return;
+                index = started_++;
+            }
+            std::string data;
+            bool ok = read_whole_file(paths_[index], data);
+            {
+                std::lock_guard<std::mutex> guard(lock_);
+                Slot& slot = slots_[index % window_];
+                slot.data = std::move(data);
+                slot.ok = ok;
+                slot.done = true;
+            }
+            done_.notify_one();
+        }
+    }
+
+#ifdef __linux__
+    // user_data: номер файла и операция в младших битах
+    enum RingOp { OP_OPEN = 0, OP_READ = 1, OP_CLOSE = 2 };
+    static constexpr size_t FIRST_READ = 16 * 1024;   // дальше буфер растёт вдвое
+
+    // файлы окна, для которых ещё не отправлен openat
+    void fill_ring() {
+        while (started_ < paths_.size() && started_ < delivered_ + window_) {
+            io_uring_sqe* sqe = ring_->get_sqe();
+            if (!sqe) return;
+            size_t index = started_;
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<uint64_t>(paths_[index].c_str());
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            sqe->user_data = (static_cast<uint64_t>(index) << 2) | OP_OPEN;
+            ops_in_flight_++;
+            std::lock_guard<std::mutex> guard(lock_);
+            ++started_;
+        }
+    }
+
+    bool queue_read(size_t index) {
+        Slot& slot = slots_[index % window_];
+        io_uring_sqe* sqe = ring_->get_sqe();
+        if (!sqe) {
+            // кольцо заполнено: отправляем накопленное и освобождаем место
+            ring_->submit(false);
+            sqe = ring_->get_sqe();
+            if (!sqe) return false;
+        }
+        slot.data.resize(slot.size + std::max(slot.size, FIRST_READ));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = slot.fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&slot.data[slot.size]);
+        sqe->len = static_cast<uint32_t>(slot.data.size() - slot.size);
+        sqe->off = slot.size;
+        sqe->user_data = (static_cast<uint64_t>(index) << 2) | OP_READ;
+        ops_in_flight_++;
+        return true;
+    }
+
+    void queue_close(size_t index) {
+        Slot& slot = slots_[index % window_];
+        io_uring_sqe* sqe = ring_->get_sqe();
+        if (!sqe) {
+            ring_->submit(false);
+            sqe = ring_->get_sqe();
+        }
+        if (!sqe) {
+            ::close(slot.fd);
+        } else {
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = slot.fd;
+            sqe->user_data = (static_cast<uint64_t>(index) << 2) | OP_CLOSE;
+            ops_in_flight_++;
+        }
+        slot.fd = -1;
+    }
+
+    void finish(size_t index, bool ok) {
+        Slot& slot = slots_[index % window_];
+        slot.data.resize(ok ? slot.size : 0);
+        slot.ok = ok;
+        if (slot.fd >= 0) queue_close(index);
+        slot.done = true;
+    }
+
+    void reap_ring() {
+        uint64_t user_data;
+        int res;
+        while (ring_->pop_cqe(user_data, res)) {
+            size_t index = static_cast<size_t>(user_data >> 2);
+            Slot& slot = slots_[index % window_];
+            ops_in_flight_--;
+            switch (static_cast<RingOp>(user_data & 3)) {
+                case OP_OPEN:
+                    if (res < 0) {
+                        finish(index, false);
+                    } else {
+                        slot.fd = res;
+                        if (!queue_read(index)) finish(index, false);
+                    }
+                    break;
+                case OP_READ:
+                    if (res < 0) {
+                        finish(index, false);
+                    } else {
+                        size_t requested = slot.data.size() - slot.size;
+                        slot.size += static_cast<size_t>(res);
+                        // короткое чтение обычного файла - конец файла
+                        if (static_cast<size_t>(res) < requested) {
+                            finish(index, true);
+                        } else if (!queue_read(index)) {
+                            finish(index, false);
+                        }
+                    }
+                    break;
+                case OP_CLOSE:
+                    // слот к этому времени может занимать уже другой файл
+                    break;
+            }
+        }
+    }
+
+    void drain_ring() {
+        while (ops_in_flight_ > 0 && ring_->submit(true)) reap_ring();
+    }
+
+    std::unique_ptr<IoUring> ring_;
+    size_t ops_in_flight_ = 0;
+#endif
+
+    std::vector<std::string> paths_;
+    size_t window_;
+    std::vector<Slot> slots_;
+    size_t started_ = 0;
+    size_t delivered_ = 0;
+    std::vector<std::thread> workers_;
+    std::mutex lock_;
+    std::condition_variable wake_workers_;
+    std::condition_variable done_;
+    bool stop_ = false;
+};
@@ -0,0 +1,171 @@
+// Метрики офлайн-конвейера: tokenizer.exe, stemmer.exe, indexer.exe (параметр --metrics <файл>).
+//
+// Каждый вызов emit() дописывает в файл одну строку JSON:
+//   {"stage":"tokenizer","event":"progress","ts":1700000000.123,"docs":1000,"bytes":...,"tokens":...,
+//    "wall_sec":...,"cpu_sec":...,"docs_per_sec":...,"bytes_per_sec":...,"tokens_per_sec":...,
+//    "peak_rss_bytes":...,"phases":{"read":{"wall_sec":...,"cpu_sec":...},...},
+//    "queues":{"имя":{"depth":...,"max":...}},"counters":{"имя":...}}
+// Фазы (read, tokenize, sort, write и т.д.) копят стеночное и процессорное время процесса.
+// Глубины очередей заполняются, только если стадия работает в несколько потоков.
+// Счётчики - произвольные числа стадии (например, пропущенные неизменившиеся документы).
+
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// процессорное время процесса (user + system), секунды
+inline double process_cpu_seconds() {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) return 0.0;
+    auto to_sec = [](const FILETIME& t) {
+        return ((static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime) / 1e7;
+    };
+    return to_sec(kernel) + to_sec(user);
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#endif
+}
+
+inline uint64_t peak_rss_bytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;  // Linux: килобайты
+#endif
+}
+
+class PipelineMetrics {
+public:
+    // path пустой - метрики считаются, но не пишутся
+    PipelineMetrics(const std::string& stage, const std::string& path)
+        : stage_(stage), start_(std::chrono::steady_clock::now()), start_cpu_(process_cpu_seconds()) {
+        if (!path.empty()) out_.open(path, std::ios::app);
+    }
+
+    void add_doc(uint64_t bytes, uint64_t tokens) {
+        std::lock_guard<std::mutex> guard(lock_);
+        ++docs_;
+        bytes_ += bytes;
+        tokens_ += tokens;
+    }
+
+    void set_queue_depth(const std::string& queue, size_t depth) {
+        std::lock_guard<std::mutex> guard(lock_);
+        QueueDepth& q = queues_[queue];
+        q.depth = depth;
+        if (depth > q.max) q.max = depth;
+    }
+
+    void set_counter(const std::string& name, uint64_t value) {
+        std::lock_guard<std::mutex> guard(lock_);
+        counters_[name] = value;
+    }
+
+    // время фазы: от создания до конца области видимости
+    class Phase {
+    public:
+        Phase(PipelineMetrics& metrics, const char* name)
+            : metrics_(metrics), name_(name), wall_(std::chrono::steady_clock::now()), cpu_(process_cpu_seconds()) {}
+        ~Phase() {
+            double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_).count();
+            metrics_.add_phase(name_, wall, process_cpu_seconds() - cpu_);
+        }
+        Phase(const Phase&) = delete;
+        Phase& operator=(const Phase&) = delete;
+
+    private:
+        PipelineMetrics& metrics_;
+        const char* name_;
+        std::chrono::steady_clock::time_point wall_;
+        double cpu_;
+    };
+
+    void emit(const std::string& event) {
+        if (!out_.is_open()) return;
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        double cpu = process_cpu_seconds() - start_cpu_;
+        double ts = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+        std::lock_guard<std::mutex> guard(lock_);
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(3);
+        line << "{\"stage\":\"" << stage_ << "\",\"event\":\"" << event << "\",\"ts\":" << ts
+             << ",\"docs\":" << docs_ << ",\"bytes\":" << bytes_ << ",\"tokens\":" << tokens_
+             << ",\"wall_sec\":" << wall << ",\"cpu_sec\":" << cpu
+             << ",\"docs_per_sec\":" << rate(docs_, wall) << ",\"bytes_per_sec\":" << rate(bytes_, wall)
+             << ",\"tokens_per_sec\":" << rate(tokens_, wall) << ",\"peak_rss_bytes\":" << peak_rss_bytes()
+             << ",\"phases\":{";
+        bool first = true;
+        for (const auto& p : phases_) {
+            line << (first ? "" : ",") << "\"" << p.first << "\":{\"wall_sec\":" << p.second.wall
+                 << ",\"cpu_sec\":" << p.second.cpu << "}";
+            first = false;
+        }
+        line << "},\"queues\":{";
+        first = true;
+        for (const auto& q : queues_) {
+            line << (first ? "" : ",") << "\"" << q.first << "\":{\"depth\":" << q.second.depth
+                 << ",\"max\":" << q.second.max << "}";
+            first = false;
+        }
+        line << "},\"counters\":{";
+        first = true;
+        for (const auto& c : counters_) {
+            line << (first ? "" : ",") << "\"" << c.first << "\":" << c.second;
+            first = false;
+        }
+        line << "}}\n";
+        out_ << line.str();
+        out_.flush();
+    }
+
+private:
+    struct PhaseTime {
+        double wall = 0.0;
+        double cpu = 0.0;
+    };
+    struct QueueDepth {
+        size_t depth = 0;
+        size_t max = 0;
+    };
+
+    static double rate(uint64_t value, double seconds) { return seconds > 0 ? value / seconds : 0.0; }
+
+    void add_phase(const char* name, double wall, double cpu) {
+        std::lock_guard<std::mutex> guard(lock_);
+        PhaseTime& p = phases_[name];
+        p.wall += wall;
+        p.cpu += cpu;
+    }
+
+    std::string stage_;
+    std::chrono::steady_clock::time_point start_;
+    double start_cpu_;
+    std::ofstream out_;
+    std::mutex lock_;
+    uint64_t docs_ = 0, bytes_ = 0, tokens_ = 0;
+    std::map<std::string, PhaseTime> phases_;
+    std::map<std::string, QueueDepth> queues_;
+    std::map<std::string, uint64_t> counters_;
+};
@@ -0,0 +1,494 @@
+// g++ -std=c++17 -O2 exporter.cpp `
+//    -I"C:\Program Files\PostgreSQL\16\include" `
+//    -L"C:\Program Files\PostgreSQL\16\lib" `
+//    -lpq -lpsapi `
+//    -o exporter.exe
+
+// .\exporter.exe ..\config.yaml [--out docs.pack] [--docstore ..\searcher\docstore.bin] [--metrics metrics.jsonl]
+// .\exporter.exe ..\config.yaml --out - | .\tokenizer.exe --input -
+
+// экспорт clean_text из PostgreSQL для tokenizer.exe: строки идут через COPY ... TO STDOUT в
+// бинарном формате и сразу пишутся одним потоком docs.pack (формат в common/docpack.h),
+// без файла на документ; вместе с текстом идёт fetch_timestamp для инкрементальной токенизации.
+// Дополнительно пишется docstore.bin для searcher.exe (формат в searcher/docstore.h) и рядом с ним
+// doc_attributes.txt - источник и дата публикации документов для indexer.exe (searcher/attributes.h).
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <chrono>
+#include <iomanip>
+#include <cstdint>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <libpq-fe.h>
+#include "../common/docpack.h"
+#include "../common/metrics.h"
+
+void setup_utf8_console() {
+#ifdef _WIN32
+    SetConsoleOutputCP(CP_UTF8);
+    SetConsoleCP(CP_UTF8);
+#endif
+}
+
+struct DBConfig {
+    std::string host;
+    int port = 5432;
+    std::string database;
+    std::string user;
+    std::string password;
+};
+
+// .env лежит рядом с config.yaml
+bool read_env_password(const std::string& env_path, std::string& password) {
+    std::ifstream env(env_path);
+    std::string line;
+    while (std::getline(env, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t eq = line.find('=');
+        if (eq != std::string::npos && line.substr(0, eq) == "DB_PASSWORD") {
+            password = line.substr(eq + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool load_db_config(const std::string& config_path, DBConfig& cfg) {
+    std::filesystem::path env_path = std::filesystem::path(config_path).parent_path() / ".env";
+    if (!read_env_password(env_path.string(), cfg.password)) {
+        std::cerr << "Не найден .env с DB_PASSWORD: " << env_path.string() << "\n";
+        return false;
+    }
+
+    std::ifstream yml(config_path);
+    if (!yml.is_open()) {
+        std::cerr << "Файл " << config_path << " не найден\n";
+        return false;
+    }
+
+    bool in_db_block = false;
+    std::string line;
+    while (std::getline(yml, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos) continue;
+        size_t end = line.find_last_not_of(" \t");
+        std::string clean_line = line.substr(start, end - start + 1);
+
+        if (clean_line == "db:") {
+            in_db_block = true;
+            continue;
+        }
+        if (!in_db_block) continue;
+        if (line[0] != ' ' && line[0] != '\t') break;
+
+        size_t colon = clean_line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string key = clean_line.substr(0, colon);
+        std::string val = clean_line.substr(colon + 1);
+        size_t vstart = val.find_first_not_of(" \t");
+        if (vstart != std::string::npos) val = val.substr(vstart);
+        if (val.size() >= 2 && val.front() == '"' && val.back() == '"') val = val.substr(1, val.size() - 2);
+
+        if (key == "host") {
+            cfg.host = val;
+        } else if (key == "port") {
+            cfg.port = std::stoi(val);
+        } else if (key == "database") {
+            cfg.database = val;
+        } else if (key == "user") {
+            cfg.user = val;
+        }
+    }
+    return true;
+}
+
+std::string connection_string(const DBConfig& cfg) {
+    std::ostringstream conn_str;
+    conn_str << "host=" << cfg.host
+             << " port=" << cfg.port
+             << " dbname=" << cfg.database
+             << " user=" << cfg.user
+             << " password=" << cfg.password
+             << " client_encoding=UTF8";
+    return conn_str.str();
+}
+
+// разбор бинарного формата COPY: заголовок "PGCOPY\n\377\r\n\0", int32 флаги, int32 длина
+// расширения и само расширение, затем кортежи: int16 число полей (-1 - конец данных),
+// у каждого поля int32 длина (-1 - NULL) и байты. Числа big-endian.
+// PQgetCopyData отдаёт данные кусками, поэтому кортеж разбирается, только когда пришёл целиком.
+class CopyBinaryParser {
+public:
+    enum Result { TUPLE, NEED_MORE, END, BAD };
+
+    void feed(const char* data, size_t size) {
+        if (pos_ > 0 && pos_ * 2 >= buf_.size()) {
+            buf_.erase(0, pos_);
+            pos_ = 0;
+        }
+        buf_.append(data, size);
+    }
+
+    // NULL отдаётся пустой строкой
+    Result next(std::vector<std::string>& fields) {
+        size_t p = pos_;
+        if (!header_done_) {
+            static const char SIGNATURE[11] = {'P', 'G', 'C', 'O', 'P', 'Y', '\n', '\377', '\r', '\n', '\0'};
+            if (available(p) < 19) return NEED_MORE;
+            if (std::memcmp(buf_.data() + p, SIGNATURE, 11) != 0) return BAD;
+            uint32_t extension = be32(p + 15);
+            if (available(p) < 19 + static_cast<size_t>(extension)) return NEED_MORE;
+            p += 19 + extension;
+            header_done_ = true;
+            pos_ = p;
+        }
+        if (available(p) < 2) return NEED_MORE;
+        int16_t count = static_cast<int16_t>(be16(p));
+        p += 2;
+        if (count == -1) {
+            pos_ = p;
+            return END;
+        }
+        if (count < 0) return BAD;
+        fields.resize(static_cast<size_t>(count));
+        for (int16_t i = 0; i < count; ++i) {
+            if (available(p) < 4) return NEED_MORE;
+            int32_t len = static_cast<int32_t>(be32(p));
+            p += 4;
+            if (len < 0) {
+                fields[i].clear();
+                continue;
+            }
+            if (available(p) < static_cast<size_t>(len)) return NEED_MORE;
+            fields[i].assign(buf_.data() + p, static_cast<size_t>(len));
+            p += static_cast<size_t>(len);
+        }
+        pos_ = p;
+        return TUPLE;
+    }
+
+private:
+    size_t available(size_t p) const { return buf_.size() - p; }
+
+    uint32_t be16(size_t p) const {
+        const unsigned char* b = reinterpret_cast<const unsigned char*>(buf_.data() + p);
+        return (b[0] << 8) | b[1];
+    }
+
+    uint32_t be32(size_t p) const {
+        const unsigned char* b = reinterpret_cast<const unsigned char*>(buf_.data() + p);
+        return (static_cast<uint32_t>(b[0]) << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+    }
+
+    std::string buf_;
+    size_t pos_ = 0;
+    bool header_done_ = false;
+};
+
+// bigint в бинарном формате - 8 байт big-endian
+long long read_be_int64(const std::string& field) {
+    if (field.size() != 8) return -1;
+    unsigned long long v = 0;
+    for (int i = 0; i < 8; ++i) {
+        v = (v << 8) | static_cast<unsigned char>(field[i]);
+    }
+    return static_cast<long long>(v);
+}
+
+// выполняет COPY (select) TO STDOUT (FORMAT binary) и отдаёт кортежи по одному по мере прихода;
+// on_row возвращает false, чтобы прервать экспорт
+bool copy_rows(PGconn* conn, const std::string& select,
+               const std::function<bool(const std::vector<std::string>&)>& on_row) {
+    std::string sql = "COPY (" + select + ") TO STDOUT (FORMAT binary)";
+    PGresult* res = PQexec(conn, sql.c_str());
+    if (PQresultStatus(res) != PGRES_COPY_OUT) {
+        std::cerr << "Ошибка COPY: " << PQerrorMessage(conn);
+        PQclear(res);
+        return false;
+    }
+    PQclear(res);
+
+    CopyBinaryParser parser;
+    std::vector<std::string> fields;
+    bool ok = true, ended = false;
+    while (true) {
+        char* data = nullptr;
+        int n = PQgetCopyData(conn, &data, 0);
+        if (n == -1) break;
+        if (n < 0) {
+            std::cerr << "Ошибка чтения COPY: " << PQerrorMessage(conn);
+            ok = false;
+            break;
+        }
+        parser.feed(data, static_cast<size_t>(n));
+        PQfreemem(data);
+        if (!ok) continue;  // дочитываем поток, чтобы соединение вернулось в обычный режим
+
+        CopyBinaryParser::Result r;
+        while ((r = parser.next(fields)) == CopyBinaryParser::TUPLE) {
+            if (!on_row(fields)) {
+                ok = false;
+                break;
+            }
+        }
+        if (r == CopyBinaryParser::END) ended = true;
+        if (r == CopyBinaryParser::BAD) {
+            std::cerr << "Неверный формат данных COPY\n";
+            ok = false;
+        }
+    }
+    while ((res = PQgetResult(conn)) != nullptr) {
+        if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+            std::cerr << "Ошибка COPY: " << PQresultErrorMessage(res);
+            ok = false;
+        }
+        PQclear(res);
+    }
+    if (ok && !ended) {
+        std::cerr << "Поток COPY оборван\n";
+        ok = false;
+    }
+    return ok;
+}
+
+bool is_blank(const std::string& text) {
+    return text.find_first_not_of(" \t\r\n\f\v") == std::string::npos;
+}
+
+// docstore.bin: заголовки и ссылки всех документов с таблицей смещений по doc_id
+
+const uint32_t DOCSTORE_FLAG_PREFIXES = 1;
+const size_t DOCSTORE_NO_PREFIX = 255;
+
+struct DocRecord {
+    uint32_t id;
+    std::string url;
+    std::string title;
+    std::string source;
+    std::string publish_date;
+};
+
+// схема, домен и первый сегмент пути: https://www.7ya.ru/article/
+std::string url_prefix(const std::string& url) {
+    size_t pos = 0;
+    for (int slash = 0; slash < 4; ++slash) {
+        pos = url.find('/', slash == 0 ? 0 : pos + 1);
+        if (pos == std::string::npos) return "";
+    }
+    return url.substr(0, pos + 1);
+}
+
+void append_le(std::string& out, uint32_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) out += static_cast<char>(v >> (8 * i));
+}
+
+bool write_doc_store(const std::vector<DocRecord>& rows, const std::string& path) {
+    // самые частые префиксы (при равенстве - в порядке первого появления)
+    std::map<std::string, size_t> prefix_counts;
+    std::vector<std::string> prefixes;
+    for (const auto& r : rows) {
+        std::string prefix = url_prefix(r.url);
+        if (prefix.empty()) continue;
+        if (prefix_counts[prefix]++ == 0) prefixes.push_back(prefix);
+    }
+    std::stable_sort(prefixes.begin(), prefixes.end(), [&](const std::string& a, const std::string& b) {
+        return prefix_counts[a] > prefix_counts[b];
+    });
+    if (prefixes.size() > DOCSTORE_NO_PREFIX) prefixes.resize(DOCSTORE_NO_PREFIX);
+    std::map<std::string, size_t> prefix_ids;
+    for (size_t i = 0; i < prefixes.size(); ++i) prefix_ids[prefixes[i]] = i;
+
+    uint32_t max_doc_id = rows.back().id;
+    std::vector<uint32_t> offsets(static_cast<size_t>(max_doc_id) + 2, 0);
+    std::string heap;
+    size_t next_row = 0;
+    for (uint32_t doc_id = 0; doc_id <= max_doc_id; ++doc_id) {
+        offsets[doc_id] = static_cast<uint32_t>(heap.size());
+        if (next_row >= rows.size() || rows[next_row].id != doc_id) continue;
+        const DocRecord& r = rows[next_row++];
+        std::string url = r.url;
+        size_t prefix_id = DOCSTORE_NO_PREFIX;
+        auto it = prefix_ids.find(url_prefix(url));
+        if (it != prefix_ids.end()) {
+            prefix_id = it->second;
+            url = url.substr(it->first.size());
+        }
+        heap += static_cast<char>(prefix_id);
+        append_le(heap, static_cast<uint32_t>(url.size()), 2);
+        heap += url;
+        heap += r.title;
+    }
+    offsets[max_doc_id + 1] = static_cast<uint32_t>(heap.size());
+
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary);
+        std::string head = "DST1";
+        append_le(head, DOCSTORE_FLAG_PREFIXES, 4);
+        append_le(head, max_doc_id, 4);
+        append_le(head, static_cast<uint32_t>(prefixes.size()), 4);
+        for (const auto& p : prefixes) {
+            append_le(head, static_cast<uint32_t>(p.size()), 2);
+            head += p;
+        }
+        out.write(head.data(), static_cast<std::streamsize>(head.size()));
+        out.write(reinterpret_cast<const char*>(offsets.data()),
+                  static_cast<std::streamsize>(offsets.size() * sizeof(uint32_t)));
+        out.write(heap.data(), static_cast<std::streamsize>(heap.size()));
+        if (!out) {
+            std::cerr << "Ошибка записи в " << tmp_path << "\n";
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec) {
+        std::cerr << "Не удалось заменить " << path << ": " << ec.message() << "\n";
+        return false;
+    }
+    return true;
+}
+
+// doc_attributes.txt: "id<TAB>source<TAB>publish_date" по строке, значения как в базе
+bool write_doc_attributes(const std::vector<DocRecord>& rows, const std::string& path) {
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary);
+        for (const auto& r : rows) {
+            out << r.id << '\t' << r.source << '\t' << r.publish_date << '\n';
+        }
+        if (!out) {
+            std::cerr << "Ошибка записи в " << tmp_path << "\n";
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec) {
+        std::cerr << "Не удалось заменить " << path << ": " << ec.message() << "\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    setup_utf8_console();
+
+    if (argc < 2) {
+        std::cerr << "Использование: exporter.exe config.yaml [--out docs.pack|-] [--docstore путь] [--metrics файл]\n";
+        return 1;
+    }
+    std::string config_path = argv[1];
+    std::string out_path = "docs.pack";
+    std::string docstore_path =
+        (std::filesystem::path(config_path).parent_path() / "searcher" / "docstore.bin").string();
+    std::string metrics_path;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (arg == "--docstore" && i + 1 < argc) {
+            docstore_path = argv[++i];
+        } else if (arg == "--metrics" && i + 1 < argc) {
+            metrics_path = argv[++i];
+        } else {
+            return 1;
+        }
+    }
+    PipelineMetrics metrics("exporter", metrics_path);
+
+    DBConfig cfg;
+    if (!load_db_config(config_path, cfg)) return 1;
+    PGconn* conn = PQconnectdb(connection_string(cfg).c_str());
+    if (PQstatus(conn) != CONNECTION_OK) {
+        std::cerr << "Ошибка подключения к БД: " << PQerrorMessage(conn);
+        PQfinish(conn);
+        return 1;
+    }
+
+    // при выводе в канал stdout занят данными, сообщения идут в stderr
+    bool to_stdout = out_path == "-";
+    std::ostream& log = to_stdout ? std::cerr : std::cout;
+    std::ofstream file;
+    std::string tmp_path = out_path + ".tmp";
+    if (to_stdout) {
+        set_binary_mode(stdout);
+    } else {
+        file.open(tmp_path, std::ios::binary);
+        if (!file) {
+            std::cerr << "Не удалось открыть " << tmp_path << "\n";
+            PQfinish(conn);
+            return 1;
+        }
+    }
+    std::ostream& out = to_stdout ? std::cout : file;
+
+    auto start = std::chrono::steady_clock::now();
+    DocPackWriter pack(out);
+    size_t total_bytes = 0;
+    bool ok = copy_rows(conn,
+                        "SELECT id, clean_text, coalesce(fetch_timestamp, 0) FROM documents "
+                        "WHERE clean_text IS NOT NULL",
+                        [&](const std::vector<std::string>& row) {
+        long long doc_id = read_be_int64(row[0]);
+        if (doc_id <= 0 || doc_id > UINT32_MAX) return true;
+        if (is_blank(row[1])) return true;
+        {
+            PipelineMetrics::Phase phase(metrics, "write");
+            pack.add(static_cast<uint32_t>(doc_id), row[1], read_be_int64(row[2]));
+        }
+        total_bytes += row[1].size();
+        metrics.add_doc(row[1].size(), 0);
+        if (pack.count() % 1000 == 0) metrics.emit("progress");
+        return static_cast<bool>(out);
+    });
+    ok = pack.finish() && ok;
+    if (!to_stdout) {
+        file.close();
+        std::error_code ec;
+        if (ok) std::filesystem::rename(tmp_path, out_path, ec);
+        if (!ok || ec) {
+            std::filesystem::remove(tmp_path, ec);
+            std::cerr << "Экспорт не завершён, " << out_path << " не изменён\n";
+            PQfinish(conn);
+            return 1;
+        }
+    }
+    if (!ok) {
+        PQfinish(conn);
+        return 1;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    log << "Экспорт завершён. Сохранено " << pack.count() << " документов с текстом ("
+        << total_bytes / (1024 * 1024) << " МБ) за " << std::fixed << std::setprecision(2) << elapsed << " сек.\n";
+
+    std::vector<DocRecord> rows;
+    ok = copy_rows(conn,
+                   "SELECT id, normalized_url, coalesce(title, ''), source, coalesce(publish_date, '') "
+                   "FROM documents ORDER BY id",
+                   [&](const std::vector<std::string>& row) {
+        long long doc_id = read_be_int64(row[0]);
+        if (doc_id <= 0 || doc_id > UINT32_MAX) return true;
+        rows.push_back({static_cast<uint32_t>(doc_id), row[1], row[2], row[3], row[4]});
+        return true;
+    });
+    PQfinish(conn);
+    if (!ok) return 1;
+    if (!rows.empty() && !write_doc_store(rows, docstore_path)) return 1;
+    log << "Хранилище заголовков и ссылок: " << rows.size() << " документов.\n";
+    std::string attributes_path = (std::filesystem::path(docstore_path).parent_path() / "doc_attributes.txt").string();
+    if (!write_doc_attributes(rows, attributes_path)) return 1;
+    metrics.emit("summary");
+    return 0;
+}
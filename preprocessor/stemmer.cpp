@@ -1,18 +1,27 @@
-// g++ -std=c++17 -O2 stemmer.cpp -o stemmer.exe
-// .\stemmer.exe
+// g++ -std=c++17 -O2 stemmer.cpp -o stemmer.exe -lpsapi
+// .\stemmer.exe [--metrics metrics.jsonl]
+// .\stemmer.exe --full            (заново все файлы, без stems/manifest.txt)
+// .\stemmer.exe --no-io-uring     (чтение пулом потоков вместо io_uring)
 
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <string>
 #include <filesystem>
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <chrono>
 #include <iomanip>
+#include "../common/metrics.h"
+#include "../common/build_manifest.h"
+#include "../common/file_batch.h"
 
 void setup_utf8_console() {
+#ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
     SetConsoleCP(CP_UTF8);
+#endif
 }
 
 // загрузка стоп слов
@@ -237,21 +246,31 @@ std::string stem(const std::string& word) {
 //     std::cout << "\nТесты пройдены: " << passed << "/" << total << std::endl;
 // }
 
-std::vector<std::string> read_tokens(const std::string& path) {
+// токены по строке
+std::vector<std::string> split_tokens(const std::string& content) {
     std::vector<std::string> tokens;
-    std::ifstream file(path, std::ios::binary);
-    if (!file.is_open()) return tokens;
-    
-    std::string line;
-    while (std::getline(file, line)) {
-        if (!line.empty()) {
-            if (line.back() == '\r') line.pop_back();
-            if (!line.empty()) tokens.push_back(line);
-        }
+    size_t pos = 0;
+    while (pos < content.size()) {
+        size_t end = content.find('\n', pos);
+        if (end == std::string::npos) end = content.size();
+        size_t len = end - pos;
+        if (len > 0 && content[end - 1] == '\r') len--;
+        if (len > 0) tokens.push_back(content.substr(pos, len));
+        pos = end + 1;
     }
     return tokens;
 }
 
+// увеличить при изменении правил стемминга: манифест станет недействительным
+const int STEMMER_RULES_VERSION = 1;
+const std::string STEMS_MANIFEST = "stems/manifest.txt";
+
+uint64_t stemmer_settings_hash(const std::vector<std::string>& stop_words) {
+    uint64_t hash = content_hash("stemmer " + std::to_string(STEMMER_RULES_VERSION));
+    for (const auto& word : stop_words) hash = content_hash(word + "\n", hash);
+    return hash;
+}
+
 void write_stems(const std::string& path, const std::vector<std::string>& stems) {
     std::ofstream file(path, std::ios::binary);
     if (!file.is_open()) {
@@ -264,9 +283,26 @@ void write_stems(const std::string& path, const std::vector<std::string>& stems)
 }
 
 
-int main() {
+int main(int argc, char* argv[]) {
     setup_utf8_console();
     // test_stemmer();
+
+    std::string metrics_path;
+    bool full = false;
+    bool use_io_uring = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--metrics" && i + 1 < argc) {
+            metrics_path = argv[++i];
+        } else if (arg == "--full") {
+            full = true;
+        } else if (arg == "--no-io-uring") {
+            use_io_uring = false;
+        } else {
+            return 1;
+        }
+    }
+    PipelineMetrics metrics("stemmer", metrics_path);
     
     auto stop_words = load_stop_words();
     const std::string in_dir = "tokens";
@@ -278,6 +314,17 @@ int main() {
     }
     
     std::filesystem::create_directories(out_dir);
+
+    // файлы токенов, не изменившиеся с прошлого запуска, не стеммируются заново; их .stems
+    // не переписываются, поэтому indexer.exe --incremental их тоже не трогает
+    BuildManifest manifest;
+    if (full) {
+        manifest.reset(stemmer_settings_hash(stop_words));
+    } else if (!manifest.load(STEMS_MANIFEST, stemmer_settings_hash(stop_words)) &&
+               std::filesystem::exists(STEMS_MANIFEST)) {
+        std::cout << "Стоп-слова или правила стемминга изменились, обрабатываются все файлы.\n";
+    }
+    ManifestReport report;
     
     int processed_files = 0;
     int total_tokens = 0;
@@ -286,39 +333,87 @@ int main() {
     auto start = std::chrono::high_resolution_clock::now();
     
     try {
+        // сначала отбираются изменившиеся файлы, затем они читаются окном (file_batch.h),
+        // пока предыдущие стеммируются
+        std::vector<int> doc_ids;
+        std::vector<long long> mtimes;
+        std::vector<std::string> paths;
+        std::vector<int> input_ids;
         for (const auto& entry : std::filesystem::directory_iterator(in_dir)) {
             if (entry.path().extension() != ".tokens") continue;
             
-            std::ifstream file(entry.path().string(), std::ios::binary | std::ios::ate);
-            size_t file_size = file.tellg();
-            file.close();
-            
-            auto tokens = read_tokens(entry.path().string());
+            int doc_id = std::stoi(entry.path().stem().string());
+            input_ids.push_back(doc_id);
+            long long mtime = file_time_value(entry.path());
+            if (manifest.same_source(doc_id, entry.file_size(), mtime)) {
+                report.skipped++;
+                continue;
+            }
+            doc_ids.push_back(doc_id);
+            mtimes.push_back(mtime);
+            paths.push_back(entry.path().string());
+        }
+
+        FileBatchReader reader(std::move(paths), use_io_uring);
+        size_t file_index = 0;
+        std::string content;
+        bool read_ok = false;
+        while (true) {
+            {
+                PipelineMetrics::Phase phase(metrics, "read");
+                if (!reader.next(file_index, content, read_ok)) break;
+            }
+            metrics.set_queue_depth("read_window", reader.in_flight());
+            int doc_id = doc_ids[file_index];
+            if (!read_ok) {
+                std::cerr << "Не удалось прочитать " << in_dir << "/" << doc_id << ".tokens\n";
+                // прежний результат остаётся (документ есть во входе), запись манифеста - тоже
+                manifest.keep(doc_id);
+                continue;
+            }
+            size_t file_size = content.size();
+            BuildManifest::State state = manifest.update(doc_id, file_size, content_hash(content), mtimes[file_index]);
+            if (state == BuildManifest::UNCHANGED) {
+                report.skipped++;
+                continue;
+            }
+            if (state == BuildManifest::NEW) {
+                report.added++;
+            } else {
+                report.changed++;
+            }
+            std::vector<std::string> tokens = split_tokens(content);
             std::vector<std::string> stems;
             stems.reserve(tokens.size());
             
-            for (const auto& tok : tokens) {
+            {
+                PipelineMetrics::Phase phase(metrics, "stem");
+                for (const auto& tok : tokens) {
 
-                if (is_stop_word(tok, stop_words)) {
-                    total_filtered++;
-                    continue;
-                }
+                    if (is_stop_word(tok, stop_words)) {
+                        total_filtered++;
+                        continue;
+                    }
 
-                std::string stemmed = stem(tok);
+                    std::string stemmed = stem(tok);
 
-                // удаляю слишком короткие стемы
-                if (utf8_char_count(stemmed) < 2) {
-                    total_filtered++;
-                    continue;
-                }
+                    // удаляю слишком короткие стемы
+                    if (utf8_char_count(stemmed) < 2) {
+                        total_filtered++;
+                        continue;
+                    }
 
-                stems.push_back(stemmed);
+                    stems.push_back(stemmed);
+                }
             }
             
-            std::string out_name = entry.path().stem().string() + ".stems";
-            std::string out_path = out_dir + "/" + out_name;
+            std::string out_path = out_dir + "/" + std::to_string(doc_id) + ".stems";
 
-            write_stems(out_path, stems);
+            {
+                PipelineMetrics::Phase phase(metrics, "write");
+                write_stems(out_path, stems);
+            }
+            metrics.add_doc(file_size, tokens.size());
             
             processed_files++;
             total_tokens += tokens.size();
@@ -331,8 +426,18 @@ int main() {
                 double speed = (elapsed > 0) ? mb / elapsed : 0.0;
 
                 std::cout << "Обработано " << processed_files << " файлов, стем: " << (total_tokens - total_filtered) << " (отфильтровано: " << total_filtered << "), скорость: " << std::fixed << std::setprecision(2) << speed << " МБ/сек\n";
+                metrics.emit("progress");
             }
         }
+
+        // токенов документа больше нет - удаляется и его .stems
+        manifest.take_unseen();
+        std::sort(input_ids.begin(), input_ids.end());
+        report.removed = remove_stale_outputs(out_dir, ".stems", input_ids);
+        if (!manifest.save(STEMS_MANIFEST)) {
+            std::cerr << "Не удалось записать " << STEMS_MANIFEST << "\n";
+            return 1;
+        }
     } catch (const std::exception& e) {
         std::cerr << "Ошибка: " << e.what() << "\n";
         return 1;
@@ -344,10 +449,16 @@ int main() {
     double avg_speed = (elapsed > 0) ? mb / elapsed : 0.0;
     
     std::cout << "\nФайлов обработано: " << processed_files << "\n";
+    std::cout << "Изменения: " << report.summary() << "\n";
     std::cout << "Всего стем: " << (total_tokens - total_filtered) << "\n";
     std::cout << "Отфильтровано стоп-слов: " << total_filtered << "\n";
     std::cout << "Время выполнения: " << std::fixed << std::setprecision(2) << elapsed << " сек\n";
     std::cout << "Средняя скорость: " << std::fixed << std::setprecision(2) << avg_speed << " МБ/сек\n";
+    metrics.set_counter("new", report.added);
+    metrics.set_counter("changed", report.changed);
+    metrics.set_counter("skipped", report.skipped);
+    metrics.set_counter("removed", report.removed);
+    metrics.emit("summary");
     
     return 0;
 }
\ No newline at end of file
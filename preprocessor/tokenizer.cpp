@@ -1,5 +1,8 @@
-// g++ -std=c++17 -O2 tokenizer.cpp -o tokenizer.exe
-// .\tokenizer.exe
+// g++ -std=c++17 -O2 tokenizer.cpp -o tokenizer.exe -lpsapi
+// .\tokenizer.exe [--metrics metrics.jsonl]
+// .\tokenizer.exe --input docs.pack        (вывод exporter.exe; "-" - чтение из stdin)
+// .\tokenizer.exe --full                   (заново все документы, без tokens/manifest.txt)
+// .\tokenizer.exe --no-io-uring            (чтение docs/ пулом потоков вместо io_uring)
 
 #include <iostream>
 #include <fstream>
@@ -9,12 +12,20 @@
 #include <chrono>
 #include <vector>
 #include <iomanip>
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <cctype>
+#include "../common/metrics.h"
+#include "../common/docpack.h"
+#include "../common/build_manifest.h"
+#include "../common/file_batch.h"
 
 void setup_utf8_console() {
+#ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
     SetConsoleCP(CP_UTF8);
+#endif
 }
 
 // является ли байт началом русской буквы
@@ -358,26 +369,70 @@ std::vector<std::string> tokenize(const std::string& text, const std::vector<std
     return tokens;
 }
 
+std::string tokens_path(int doc_id) {
+    return "tokens/" + std::to_string(doc_id) + ".tokens";
+}
+
 void save_tokens(int doc_id, const std::vector<std::string>& tokens) {
     std::filesystem::create_directories("tokens");
-    std::string path = "tokens/" + std::to_string(doc_id) + ".tokens";
-    std::ofstream out(path, std::ios::binary);
+    std::ofstream out(tokens_path(doc_id), std::ios::binary);
     for (const auto& t : tokens) {
         out << t << '\n';
     }
 }
 
-std::string read_file(const std::string& path) {
-    std::ifstream f(path, std::ios::binary);
-    if (!f) return "";
-    return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+void remove_tokens(int doc_id) {
+    std::error_code ec;
+    std::filesystem::remove(tokens_path(doc_id), ec);
+}
+
+// увеличить при изменении правил токенизации: манифест станет недействительным
+const int TOKENIZER_RULES_VERSION = 1;
+const std::string TOKENS_MANIFEST = "tokens/manifest.txt";
+
+uint64_t tokenizer_settings_hash(const std::vector<std::string>& known_abbrevs) {
+    uint64_t hash = content_hash("tokenizer " + std::to_string(TOKENIZER_RULES_VERSION));
+    for (const auto& abbrev : known_abbrevs) hash = content_hash(abbrev + "\n", hash);
+    return hash;
 }
 
 
-int main() {
+
+int main(int argc, char* argv[]) {
     setup_utf8_console();
+
+    std::string metrics_path;
+    std::string input_path;
+    bool full = false;
+    bool use_io_uring = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--metrics" && i + 1 < argc) {
+            metrics_path = argv[++i];
+        } else if (arg == "--input" && i + 1 < argc) {
+            input_path = argv[++i];
+        } else if (arg == "--full") {
+            full = true;
+        } else if (arg == "--no-io-uring") {
+            use_io_uring = false;
+        } else {
+            return 1;
+        }
+    }
+    PipelineMetrics metrics("tokenizer", metrics_path);
     
     auto known_abbrevs = load_known_abbrevs();
+
+    // документы, не изменившиеся с прошлого запуска, не токенизируются заново
+    BuildManifest manifest;
+    if (full) {
+        manifest.reset(tokenizer_settings_hash(known_abbrevs));
+    } else if (!manifest.load(TOKENS_MANIFEST, tokenizer_settings_hash(known_abbrevs)) &&
+               std::filesystem::exists(TOKENS_MANIFEST)) {
+        std::cout << "Сокращения или правила токенизации изменились, обрабатываются все документы.\n";
+    }
+    ManifestReport report;
+    std::vector<int> input_ids;
     int processed_docs = 0;
     long long total_tokens = 0;
     long long total_token_chars = 0;
@@ -385,34 +440,135 @@ int main() {
 
     auto start = std::chrono::high_resolution_clock::now();
 
-    try {
-        for (const auto& entry : std::filesystem::directory_iterator("docs")) {
-            if (entry.path().extension() != ".txt") continue;
-
-            std::string text = read_file(entry.path().string());
-            if (text.empty()) continue;
+    auto process_doc = [&](int doc_id, const std::string& text, long long source_time) {
+        BuildManifest::State state = manifest.update(doc_id, text.size(), content_hash(text), source_time);
+        if (state == BuildManifest::UNCHANGED) {
+            report.skipped++;
+            return;
+        }
+        if (state == BuildManifest::NEW) {
+            report.added++;
+        } else {
+            report.changed++;
+        }
 
-            total_input_bytes += text.size();
-            auto tokens = tokenize(text, known_abbrevs);
-            if (tokens.empty()) continue;
+        std::vector<std::string> tokens;
+        if (!text.empty()) {
+            PipelineMetrics::Phase phase(metrics, "tokenize");
+            tokens = tokenize(text, known_abbrevs);
+        }
+        total_input_bytes += text.size();
+        if (tokens.empty()) {
+            remove_tokens(doc_id);
+            return;
+        }
 
-            std::string stem = entry.path().stem().string();
-            int doc_id = std::stoi(stem);
+        {
+            PipelineMetrics::Phase phase(metrics, "write");
             save_tokens(doc_id, tokens);
+        }
+        metrics.add_doc(text.size(), tokens.size());
 
-            total_tokens += tokens.size();
-            for (const auto& t : tokens) {
-                total_token_chars += count_utf8_chars(t);
+        total_tokens += tokens.size();
+        for (const auto& t : tokens) {
+            total_token_chars += count_utf8_chars(t);
+        }
+        processed_docs++;
+
+        if (processed_docs % 1000 == 0) {
+            auto now = std::chrono::high_resolution_clock::now();
+            double elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(now - start).count();
+            double kb = total_input_bytes / 1024.0;
+            double speed = (elapsed > 0) ? kb / elapsed : 0.0;
+            std::cout << "Обработано " << processed_docs << " документов, токенов: " << total_tokens << ", скорость: " << std::fixed << std::setprecision(2) << speed << " КБ/сек\n";
+            metrics.emit("progress");
+        }
+    };
+
+    try {
+        if (!input_path.empty()) {
+            // один поток документов от exporter.exe вместо каталога docs/
+            std::ifstream file;
+            if (input_path == "-") {
+                set_binary_mode(stdin);
+            } else {
+                file.open(input_path, std::ios::binary);
+            }
+            std::istream& in = input_path == "-" ? std::cin : file;
+            DocPackReader reader(in);
+            if (!reader.valid()) {
+                std::cerr << "Неверный формат " << input_path << " (ожидается вывод exporter.exe)\n";
+                return 1;
+            }
+            uint32_t doc_id = 0;
+            int64_t source_time = 0;
+            std::string text;
+            while (true) {
+                {
+                    PipelineMetrics::Phase phase(metrics, "read");
+                    if (!reader.next(doc_id, text, &source_time)) break;
+                }
+                input_ids.push_back(static_cast<int>(doc_id));
+                // тот же fetch_timestamp и размер - статья не перекачивалась, хэш можно не считать
+                if (manifest.same_source(static_cast<int>(doc_id), text.size(), source_time)) {
+                    report.skipped++;
+                    continue;
+                }
+                process_doc(static_cast<int>(doc_id), text, source_time);
             }
-            processed_docs++;
-
-            if (processed_docs % 1000 == 0) {
-                auto now = std::chrono::high_resolution_clock::now();
-                double elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(now - start).count();
-                double kb = total_input_bytes / 1024.0;
-                double speed = (elapsed > 0) ? kb / elapsed : 0.0;
-                std::cout << "Обработано " << processed_docs << " документов, токенов: " << total_tokens << ", скорость: " << std::fixed << std::setprecision(2) << speed << " КБ/сек\n";
+            if (!reader.complete()) {
+                std::cerr << "Поток " << input_path << " оборван после " << processed_docs << " документов\n";
+                return 1;
             }
+        } else {
+            // сначала отбираются изменившиеся файлы, затем они читаются окном (file_batch.h),
+            // пока предыдущие токенизируются
+            std::vector<int> doc_ids;
+            std::vector<long long> mtimes;
+            std::vector<std::string> paths;
+            for (const auto& entry : std::filesystem::directory_iterator("docs")) {
+                if (entry.path().extension() != ".txt") continue;
+
+                int doc_id = std::stoi(entry.path().stem().string());
+                input_ids.push_back(doc_id);
+                long long mtime = file_time_value(entry.path());
+                if (manifest.same_source(doc_id, entry.file_size(), mtime)) {
+                    report.skipped++;
+                    continue;
+                }
+                doc_ids.push_back(doc_id);
+                mtimes.push_back(mtime);
+                paths.push_back(entry.path().string());
+            }
+
+            FileBatchReader reader(std::move(paths), use_io_uring);
+            size_t file_index = 0;
+            std::string text;
+            bool read_ok = false;
+            while (true) {
+                {
+                    PipelineMetrics::Phase phase(metrics, "read");
+                    if (!reader.next(file_index, text, read_ok)) break;
+                }
+                metrics.set_queue_depth("read_window", reader.in_flight());
+                if (!read_ok) {
+                    std::cerr << "Не удалось прочитать docs/" << doc_ids[file_index] << ".txt\n";
+                    // прежний результат остаётся (документ есть во входе), запись манифеста - тоже
+                    manifest.keep(doc_ids[file_index]);
+                    continue;
+                }
+                process_doc(doc_ids[file_index], text, mtimes[file_index]);
+            }
+        }
+
+        // документов, которых больше нет во входе, нет и в tokens/
+        std::filesystem::create_directories("tokens");
+        manifest.take_unseen();
+        std::sort(input_ids.begin(), input_ids.end());
+        report.removed = remove_stale_outputs("tokens", ".tokens", input_ids);
+        if (!manifest.save(TOKENS_MANIFEST)) {
+            std::cerr << "Не удалось записать " << TOKENS_MANIFEST << "\n";
+            return 1;
         }
     } catch (const std::exception& e) {
         std::cerr << "Ошибка: " << e.what() << "\n";
@@ -426,10 +582,16 @@ int main() {
     double avg_len = total_tokens > 0 ? static_cast<double>(total_token_chars) / total_tokens : 0.0;
 
     std::cout << "\nДокументов обработано: " << processed_docs << "\n";
+    std::cout << "Изменения: " << report.summary() << "\n";
     std::cout << "Всего токенов: " << total_tokens << "\n";
     std::cout << "Средняя длина токена: " << std::fixed << std::setprecision(2) << avg_len << " символов\n";
     std::cout << "Время выполнения: " << std::fixed << std::setprecision(2) << duration << " сек\n";
     std::cout << "Скорость токенизации: " << std::fixed << std::setprecision(2) << speed_kb_sec << " КБ/сек\n";
+    metrics.set_counter("new", report.added);
+    metrics.set_counter("changed", report.changed);
+    metrics.set_counter("skipped", report.skipped);
+    metrics.set_counter("removed", report.removed);
+    metrics.emit("summary");
 
     return 0;
 }
\ No newline at end of file
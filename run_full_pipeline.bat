@@ -70,16 +70,16 @@ cd ..
 
 :: Экспорт текстов
 echo [5/7] Экспорт clean_text из БД...
-python preprocessor/export_clean_text.py config.yaml
+preprocessor\exporter.exe config.yaml --out docs.pack
 if errorlevel 1 (
-    echo Ошибка в export_clean_text.py
+    echo Ошибка в exporter.exe
     pause
     exit /b 1
 )
 
 :: Токенизация и стемминг
 echo [6/7] Токенизация и стемминг...
-preprocessor\tokenizer.exe
+preprocessor\tokenizer.exe --input docs.pack
 preprocessor\stemmer.exe
 
 :: Индексация
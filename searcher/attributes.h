@@ -0,0 +1,285 @@
+// Атрибуты документов для фильтров source: и date: (searcher.exe).
+//
+// exporter.exe пишет doc_attributes.txt: по строке на документ "id<TAB>source<TAB>publish_date" из базы.
+// indexer.exe переводит его в столбцы по doc_id индекса (с учётом --reorder и --drop-duplicates)
+// и пишет attributes.bin. Сегмент обычно содержит малую часть doc_id базы, тогда его <имя>.attr хранит
+// строки только своих документов (отсортированный список doc_id, строка - позиция в нём); в полном
+// индексе строка - сам doc_id. Источник хранится номером в списке источников
+// (0 - неизвестен), дата - числом дней с 1970-01-01 (0 - неизвестна). Для каждого источника
+// дополнительно хранится битовая карта его doc_id: фильтр по источнику внутри обхода posting листа -
+// проверка одного бита, а запрос из одного source: - сборка отмеченных doc_id.
+//
+// attributes.bin, числа в порядке байт машины:
+//   "ATR1", uint32 число doc_id, uint32 число источников, источники (uint16 длина + байты)
+//   uint8 источник[doc_id], uint16 дни[doc_id], битовые карты источников (uint64 слова подряд)
+// <имя>.attr со строками: "ATR2", те же поля по строкам, после источников - int32 doc_id строк
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// дни с 1970-01-01 по григорианскому календарю
+inline int days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// число из цифр s[pos, pos + len), -1 - там не только цифры
+inline int parse_digits(const std::string& s, size_t pos, size_t len) {
+    int value = 0;
+    for (size_t i = pos; i < pos + len; ++i) {
+        if (s[i] < '0' || s[i] > '9') return -1;
+        value = value * 10 + (s[i] - '0');
+    }
+    return value;
+}
+
+// "ГГГГ", "ГГГГ-ММ" или "ГГГГ-ММ-ДД" -> первый (upper = false) или последний день периода
+inline bool parse_date_bound(const std::string& s, bool upper, int& days) {
+    bool has_month = s.size() == 7 || s.size() == 10;
+    bool has_day = s.size() == 10;
+    if (s.size() != 4 && !has_month) return false;
+    if ((has_month && s[4] != '-') || (has_day && s[7] != '-')) return false;
+    int y = parse_digits(s, 0, 4);
+    int m = has_month ? parse_digits(s, 5, 2) : 1;
+    int d = has_day ? parse_digits(s, 8, 2) : 1;
+    if (y < 1970 || m < 1 || m > 12 || d < 1 || d > 31) return false;
+    if (!upper || has_day) {
+        days = days_from_civil(y, m, d);
+    } else if (has_month) {
+        days = days_from_civil(m == 12 ? y + 1 : y, m % 12 + 1, 1) - 1;
+    } else {
+        days = days_from_civil(y + 1, 1, 1) - 1;
+    }
+    return true;
+}
+
+// date:2023, date:2023-05..2023-06-15, date:2023-01-01.., date:..2022 -> [from, to] в днях
+inline bool parse_date_range(const std::string& spec, int& from, int& to) {
+    size_t dots = spec.find("..");
+    std::string lo = dots == std::string::npos ? spec : spec.substr(0, dots);
+    std::string hi = dots == std::string::npos ? spec : spec.substr(dots + 2);
+    if (lo.empty() && hi.empty()) return false;
+    from = 1;
+    to = UINT16_MAX;
+    if (!lo.empty() && !parse_date_bound(lo, false, from)) return false;
+    if (!hi.empty() && !parse_date_bound(hi, true, to)) return false;
+    return from <= to;
+}
+
+// дата из базы: начало строки "ГГГГ-ММ-ДД" (у части сайтов дальше идёт время); 0 - не разобрать
+inline uint16_t publish_day(const std::string& publish_date) {
+    int days = 0;
+    if (publish_date.size() < 10 || !parse_date_bound(publish_date.substr(0, 10), false, days)) return 0;
+    return days > 0 && days <= UINT16_MAX ? static_cast<uint16_t>(days) : 0;
+}
+
+class DocAttributes {
+public:
+    // doc_attributes.txt от exporter.exe: столбцы по id в базе
+    bool read_table(const std::string& path) {
+        *this = DocAttributes();
+        std::ifstream in(path);
+        if (!in.is_open()) return false;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            size_t tab1 = line.find('\t');
+            size_t tab2 = tab1 == std::string::npos ? std::string::npos : line.find('\t', tab1 + 1);
+            if (tab2 == std::string::npos) continue;
+            int id = std::atoi(line.substr(0, tab1).c_str());
+            if (id <= 0) continue;
+            // searcher.exe приводит запрос к нижнему регистру
+            std::string source = line.substr(tab1 + 1, tab2 - tab1 - 1);
+            for (char& c : source) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            set(id, intern_source(source), publish_day(line.substr(tab2 + 1)));
+        }
+        build_bitmaps();
+        return true;
+    }
+
+    // атрибуты документов индекса docs из table (по id в базе); db_ids - id в базе по doc_id индекса,
+    // пусто - doc_id индекса и есть id в базе
+    void select(const DocAttributes& table, const std::vector<int>& docs, const std::vector<int>& db_ids) {
+        *this = DocAttributes();
+        sources_ = table.sources_;
+        for (int doc : docs) {
+            int id = db_ids.empty() ? doc : db_ids[doc];
+            if (static_cast<size_t>(id) < table.source_.size()) set(doc, table.source_[id], table.day_[id]);
+        }
+        build_bitmaps();
+    }
+
+    // атрибуты документов сегмента (doc_id сегмента - id в базе): строки только для docs,
+    // если это меньше столбцов по всем doc_id до наибольшего из docs
+    void select_rows(const DocAttributes& table, const std::vector<int>& docs) {
+        std::vector<int32_t> ids(docs.begin(), docs.end());
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        size_t dense_rows = ids.empty() ? 0 : static_cast<size_t>(ids.back()) + 1;
+        size_t bitmap_bytes = table.sources_.size() / 8;
+        if (dense_rows * (3 + bitmap_bytes) <= ids.size() * (3 + sizeof(int32_t) + bitmap_bytes)) {
+            select(table, docs, {});
+            return;
+        }
+        *this = DocAttributes();
+        sources_ = table.sources_;
+        ids_ = std::move(ids);
+        source_.assign(ids_.size(), 0);
+        day_.assign(ids_.size(), 0);
+        for (size_t row = 0; row < ids_.size(); ++row) {
+            size_t id = static_cast<size_t>(ids_[row]);
+            if (id < table.source_.size()) {
+                source_[row] = table.source_[id];
+                day_[row] = table.day_[id];
+            }
+        }
+        build_bitmaps();
+    }
+
+    bool write(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) return false;
+        uint32_t header[2] = {static_cast<uint32_t>(source_.size()), static_cast<uint32_t>(sources_.size())};
+        out.write(ids_.empty() ? "ATR1" : "ATR2", 4);
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        for (const auto& name : sources_) {
+            uint16_t len = static_cast<uint16_t>(name.size());
+            out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+            out.write(name.data(), len);
+        }
+        out.write(reinterpret_cast<const char*>(ids_.data()), ids_.size() * sizeof(int32_t));
+        out.write(reinterpret_cast<const char*>(source_.data()), source_.size());
+        out.write(reinterpret_cast<const char*>(day_.data()), day_.size() * sizeof(uint16_t));
+        for (const auto& bits : bits_) {
+            out.write(reinterpret_cast<const char*>(bits.data()), bits.size() * sizeof(uint64_t));
+        }
+        return static_cast<bool>(out);
+    }
+
+    bool load(const std::string& path) {
+        *this = DocAttributes();
+        std::ifstream in(path, std::ios::binary);
+        char magic[4];
+        uint32_t header[2];
+        if (!in.read(magic, 4)) return false;
+        std::string format(magic, 4);
+        if (format != "ATR1" && format != "ATR2") return false;
+        if (!in.read(reinterpret_cast<char*>(header), sizeof(header))) return false;
+        for (uint32_t i = 0; i < header[1] && in; ++i) {
+            uint16_t len = 0;
+            in.read(reinterpret_cast<char*>(&len), sizeof(len));
+            std::string name(len, '\0');
+            in.read(&name[0], len);
+            sources_.push_back(name);
+        }
+        if (format == "ATR2") {
+            ids_.resize(header[0]);
+            in.read(reinterpret_cast<char*>(ids_.data()), ids_.size() * sizeof(int32_t));
+        }
+        source_.resize(header[0]);
+        day_.resize(header[0]);
+        in.read(reinterpret_cast<char*>(source_.data()), source_.size());
+        in.read(reinterpret_cast<char*>(day_.data()), day_.size() * sizeof(uint16_t));
+        bits_.assign(sources_.size(), std::vector<uint64_t>(words()));
+        for (auto& bits : bits_) in.read(reinterpret_cast<char*>(bits.data()), bits.size() * sizeof(uint64_t));
+        if (!in) {
+            *this = DocAttributes();
+            return false;
+        }
+        return true;
+    }
+
+    bool empty() const { return source_.empty(); }
+    size_t doc_count() const { return source_.size(); }
+    int doc_at(size_t row) const { return ids_.empty() ? static_cast<int>(row) : ids_[row]; }
+
+    size_t memory_bytes() const {
+        return source_.capacity() + day_.capacity() * sizeof(uint16_t) + bits_.size() * words() * sizeof(uint64_t) +
+               ids_.capacity() * sizeof(int32_t);
+    }
+
+    // номер источника или -1
+    int source_id(const std::string& name) const {
+        for (size_t i = 1; i < sources_.size(); ++i) {
+            if (sources_[i] == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    bool in_source(int doc, int source) const {
+        long long r = row(doc);
+        return r >= 0 && (bits_[source][static_cast<size_t>(r) >> 6] >> (r & 63) & 1);
+    }
+
+    // дни с 1970-01-01, 0 - дата неизвестна или документа нет
+    uint16_t day(int doc) const {
+        long long r = row(doc);
+        return r >= 0 ? day_[static_cast<size_t>(r)] : 0;
+    }
+
+    // doc_id источника по возрастанию
+    std::vector<int> source_docs(int source) const {
+        std::vector<int> docs;
+        const std::vector<uint64_t>& bits = bits_[source];
+        for (size_t w = 0; w < bits.size(); ++w) {
+            for (uint64_t word = bits[w]; word != 0; word &= word - 1) {
+                docs.push_back(doc_at(w * 64 + __builtin_ctzll(word)));
+            }
+        }
+        return docs;
+    }
+
+private:
+    size_t words() const { return (source_.size() + 63) / 64; }
+
+    // строка документа или -1
+    long long row(int doc) const {
+        if (ids_.empty()) return doc >= 0 && static_cast<size_t>(doc) < source_.size() ? doc : -1;
+        auto it = std::lower_bound(ids_.begin(), ids_.end(), doc);
+        return it != ids_.end() && *it == doc ? it - ids_.begin() : -1;
+    }
+
+    // источников не больше 255, остальные считаются неизвестными
+    uint8_t intern_source(const std::string& name) {
+        if (sources_.empty()) sources_.push_back("");
+        int id = source_id(name);
+        if (id >= 0) return static_cast<uint8_t>(id);
+        if (sources_.size() > UINT8_MAX) return 0;
+        sources_.push_back(name);
+        return static_cast<uint8_t>(sources_.size() - 1);
+    }
+
+    void set(int doc, uint8_t source, uint16_t day) {
+        if (static_cast<size_t>(doc) >= source_.size()) {
+            source_.resize(static_cast<size_t>(doc) + 1, 0);
+            day_.resize(static_cast<size_t>(doc) + 1, 0);
+        }
+        source_[doc] = source;
+        day_[doc] = day;
+    }
+
+    void build_bitmaps() {
+        if (sources_.empty()) sources_.push_back("");
+        bits_.assign(sources_.size(), std::vector<uint64_t>(words(), 0));
+        for (size_t doc = 0; doc < source_.size(); ++doc) {
+            if (source_[doc] != 0) bits_[source_[doc]][doc >> 6] |= uint64_t(1) << (doc & 63);
+        }
+    }
+
+    std::vector<std::string> sources_;  // [0] - неизвестный источник
+    std::vector<int32_t> ids_;  // doc_id строк (сегмент), пусто - строка и есть doc_id
+    std::vector<uint8_t> source_;
+    std::vector<uint16_t> day_;
+    std::vector<std::vector<uint64_t>> bits_;
+};
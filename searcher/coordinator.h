@@ -0,0 +1,215 @@
+// Координатор шардов (searcher.exe --coordinator): запрос рассылается searcher.exe --serve всех шардов
+// (shards.h) по локальным сокетам, ответы собираются, пока не истечёт время ожидания.
+// Шард, не ответивший вовремя, пропускается: ответ собирается из остальных и помечается как неполный.
+//
+// С каждым шардом держится пул соединений: запрос берёт свободное соединение на время ответа,
+// так ответы одного соединения не перемешиваются. Соединение, по которому ответ не пришёл вовремя,
+// закрывается: иначе опоздавший ответ получил бы следующий запрос.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "net.h"
+
+const int DEFAULT_SHARD_TIMEOUT_MS = 1000;
+
+struct ShardAddress {
+    std::string host = "127.0.0.1";
+    int port = 0;
+};
+
+// "host:port" или "port"
+inline bool parse_shard_address(const std::string& spec, ShardAddress& address) {
+    size_t colon = spec.rfind(':');
+    std::string port = colon == std::string::npos ? spec : spec.substr(colon + 1);
+    if (colon != std::string::npos) address.host = spec.substr(0, colon);
+    if (port.empty() || port.find_first_not_of("0123456789") != std::string::npos || port.size() > 5) return false;
+    address.port = std::stoi(port);
+    return address.port > 0 && address.port < 65536 && !address.host.empty();
+}
+
+class ShardChannel {
+public:
+    explicit ShardChannel(ShardAddress address) : address_(std::move(address)) {}
+    ~ShardChannel() {
+        for (socket_t s : idle_) close_socket(s);
+    }
+    ShardChannel(const ShardChannel&) = delete;
+    ShardChannel& operator=(const ShardChannel&) = delete;
+
+    const ShardAddress& address() const { return address_; }
+
+    // свободное соединение или новое; INVALID_SOCK - шард недоступен
+    socket_t acquire() {
+        while (true) {
+            socket_t s;
+            {
+                std::lock_guard<std::mutex> guard(lock_);
+                if (idle_.empty()) break;
+                s = idle_.back();
+                idle_.pop_back();
+            }
+            // шард мог перезапуститься, пока соединение лежало в пуле
+            char c;
+            int n = recv(s, &c, 1, MSG_PEEK);
+            if (n < 0 && last_error_would_block()) return s;
+            close_socket(s);
+        }
+        socket_t s = connect_tcp(address_.host, address_.port);
+        if (s != INVALID_SOCK) set_nonblocking(s);
+        return s;
+    }
+
+    void release(socket_t s) {
+        std::lock_guard<std::mutex> guard(lock_);
+        idle_.push_back(s);
+    }
+
+private:
+    ShardAddress address_;
+    std::mutex lock_;
+    std::vector<socket_t> idle_;
+};
+
+// ответ шарда одной строкой; answered = false - шард недоступен или не уложился во время
+struct ShardReply {
+    bool answered = false;
+    std::string line;
+};
+
+struct CoordinatorStats {
+    uint64_t queries = 0;
+    uint64_t partial = 0;     // запросов, на которые ответили не все шарды
+    uint64_t timeouts = 0;    // ответов, не пришедших вовремя
+    uint64_t unavailable = 0; // шард не принял соединение или запрос
+};
+
+class ShardCoordinator {
+public:
+    ShardCoordinator(const std::vector<ShardAddress>& shards, std::chrono::milliseconds timeout) : timeout_(timeout) {
+        for (const auto& address : shards) channels_.push_back(std::make_unique<ShardChannel>(address));
+    }
+
+    size_t shard_count() const { return channels_.size(); }
+    const ShardAddress& address(size_t shard) const { return channels_[shard]->address(); }
+    std::chrono::milliseconds timeout() const { return timeout_; }
+
+    // запрос всем шардам сразу, затем ожидание ответов по poll до общего срока
+    std::vector<ShardReply> scatter(const std::string& query) {
+        const size_t n = channels_.size();
+        std::vector<ShardReply> replies(n);
+        std::vector<socket_t> socks(n, INVALID_SOCK);
+        std::vector<std::string> input(n);
+        size_t waiting = 0;
+        for (size_t i = 0; i < n; ++i) {
+            socket_t s = channels_[i]->acquire();
+            if (s != INVALID_SOCK && !send_all(s, query + "\n")) {
+                close_socket(s);
+                s = INVALID_SOCK;
+            }
+            if (s == INVALID_SOCK) {
+                unavailable_++;
+                continue;
+            }
+            socks[i] = s;
+            ++waiting;
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + timeout_;
+        std::vector<pollfd> fds;
+        std::vector<size_t> shard_of;
+        while (waiting > 0) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) break;
+            fds.clear();
+            shard_of.clear();
+            for (size_t i = 0; i < n; ++i) {
+                if (socks[i] == INVALID_SOCK) continue;
+                pollfd pfd{};
+                pfd.fd = socks[i];
+                pfd.events = POLLIN;
+                fds.push_back(pfd);
+                shard_of.push_back(i);
+            }
+            if (poll_sockets(fds.data(), fds.size(), static_cast<int>(left.count())) < 0 && !last_error_interrupted()) {
+                break;
+            }
+            for (size_t k = 0; k < fds.size(); ++k) {
+                if (!fds[k].revents) continue;
+                size_t i = shard_of[k];
+                if (!read_reply(socks[i], input[i], replies[i])) {
+                    close_socket(socks[i]);
+                    unavailable_++;
+                } else if (replies[i].answered) {
+                    channels_[i]->release(socks[i]);
+                } else {
+                    continue;
+                }
+                socks[i] = INVALID_SOCK;
+                --waiting;
+            }
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (socks[i] == INVALID_SOCK) continue;
+            close_socket(socks[i]);
+            timeouts_++;
+        }
+
+        queries_++;
+        for (const auto& reply : replies) {
+            if (!reply.answered) {
+                partial_++;
+                break;
+            }
+        }
+        return replies;
+    }
+
+    CoordinatorStats stats() const {
+        CoordinatorStats s;
+        s.queries = queries_;
+        s.partial = partial_;
+        s.timeouts = timeouts_;
+        s.unavailable = unavailable_;
+        return s;
+    }
+
+private:
+    static bool last_error_interrupted() {
+#ifdef _WIN32
+        return false;
+#else
+        return errno == EINTR;
+#endif
+    }
+
+    // дочитывает доступное; false - соединение закрыто до конца строки ответа
+    static bool read_reply(socket_t s, std::string& input, ShardReply& reply) {
+        char chunk[65536];
+        while (true) {
+            int got = recv(s, chunk, sizeof(chunk), 0);
+            if (got > 0) {
+                input.append(chunk, static_cast<size_t>(got));
+                continue;
+            }
+            if (got < 0 && last_error_would_block()) break;
+            return false;
+        }
+        size_t nl = input.find('\n');
+        if (nl == std::string::npos) return true;
+        reply.line = input.substr(0, nl);
+        if (!reply.line.empty() && reply.line.back() == '\r') reply.line.pop_back();
+        reply.answered = true;
+        return true;
+    }
+
+    std::vector<std::unique_ptr<ShardChannel>> channels_;
+    std::chrono::milliseconds timeout_;
+    std::atomic<uint64_t> queries_{0}, partial_{0}, timeouts_{0}, unavailable_{0};
+};
@@ -0,0 +1,197 @@
+// Перенумерация документов (indexer.exe --reorder).
+//
+// doc_id из базы идут в порядке обхода: статьи разных сайтов и тем перемешаны, и разности соседних
+// doc_id в posting листах большие. Индексатор выдаёт документам новые номера 0..n-1 так, чтобы
+// похожие документы стояли рядом: сначала документы сортируются по ссылке без схемы и www
+// (сайт, затем раздел), затем порядок уточняется рекурсивным делением пополам (graph bisection):
+// часть делится на две половины, и документы меняются местами между ними, пока это уменьшает
+// оценку размера разностей doc_id по терминам обеих половин; потом так же делится каждая половина.
+// Оценка для термина, который есть в deg документах из n: deg * log2(n / (deg + 1)) бит.
+//
+// doc_ids.txt - id документа в базе для каждого нового номера, по строке (как <сегмент>.docs).
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+const std::string DOC_MAP_FILE = "doc_ids.txt";
+
+const size_t REORDER_MIN_PARTITION = 16;  // меньшие части не делятся
+const int REORDER_ITERATIONS = 20;        // обменов между половинами на одном уровне, не больше
+const int REORDER_PARALLEL_DEPTH = 3;     // до этой глубины половины делятся в отдельных потоках
+
+inline bool write_doc_map(const std::string& path, const std::vector<int>& db_ids) {
+    std::ofstream out(path);
+    if (!out.is_open()) return false;
+    for (int id : db_ids) out << id << "\n";
+    return static_cast<bool>(out);
+}
+
+inline std::vector<int> read_doc_map(const std::string& path) {
+    std::vector<int> db_ids;
+    std::ifstream in(path);
+    int id;
+    while (in >> id) db_ids.push_back(id);
+    return db_ids;
+}
+
+// ключ сортировки по ссылке: без схемы и www, чтобы http и https одного сайта шли вместе
+inline std::string url_order_key(const std::string& url) {
+    size_t begin = url.find("://");
+    begin = begin == std::string::npos ? 0 : begin + 3;
+    if (url.compare(begin, 4, "www.") == 0) begin += 4;
+    return url.substr(begin);
+}
+
+// байт posting листов в памяти searcher.exe (разности doc_id в varint)
+inline size_t packed_postings_bytes(const std::vector<std::vector<int>>& postings) {
+    size_t bytes = 0;
+    for (const auto& list : postings) {
+        unsigned int prev = 0;
+        for (int id : list) {
+            unsigned int delta = static_cast<unsigned int>(id) - prev;
+            prev = static_cast<unsigned int>(id);
+            do {
+                ++bytes;
+                delta >>= 7;
+            } while (delta != 0);
+        }
+    }
+    return bytes;
+}
+
+class GraphBisection {
+public:
+    // doc_terms[d] - номера терминов документа d (только терминов, которые есть больше чем в одном документе)
+    GraphBisection(const std::vector<std::vector<uint32_t>>& doc_terms, size_t term_count)
+        : doc_terms_(doc_terms), term_count_(term_count), log2_(doc_terms.size() + 2, 0.0f) {
+        for (size_t i = 1; i < log2_.size(); ++i) log2_[i] = static_cast<float>(std::log2(static_cast<double>(i)));
+    }
+
+    // order - начальный порядок документов, на выходе - уточнённый
+    void run(std::vector<uint32_t>& order) const {
+        bisect(order.data(), order.size(), 0);
+    }
+
+private:
+    // степени терминов в половинах; после деления обнуляются только затронутые термины
+    struct Scratch {
+        std::vector<uint32_t> left, right;
+        std::vector<std::pair<float, uint32_t>> left_gains, right_gains;
+    };
+
+    float cost(uint32_t deg, size_t n) const { return deg * (log2_[n] - log2_[deg + 1]); }
+
+    // выигрыш от переноса документа из части from (deg_from документов с термином из n_from) в часть to
+    float move_gain(const std::vector<uint32_t>& terms, const std::vector<uint32_t>& from, const std::vector<uint32_t>& to,
+                    size_t n_from, size_t n_to) const {
+        float gain = 0.0f;
+        for (uint32_t t : terms) {
+            uint32_t a = from[t], b = to[t];
+            gain += cost(a, n_from) + cost(b, n_to) - cost(a - 1, n_from) - cost(b + 1, n_to);
+        }
+        return gain;
+    }
+
+    Scratch make_scratch() const {
+        Scratch scratch;
+        scratch.left.assign(term_count_, 0);
+        scratch.right.assign(term_count_, 0);
+        return scratch;
+    }
+
+    // верхние уровни: половины делятся параллельно, у каждого потока свои массивы степеней
+    void bisect(uint32_t* docs, size_t n, int depth) const {
+        if (depth >= REORDER_PARALLEL_DEPTH) {
+            bisect_serial(docs, n);
+            return;
+        }
+        if (n <= REORDER_MIN_PARTITION) return;
+        {
+            Scratch scratch = make_scratch();
+            split(docs, n, scratch);
+        }
+        size_t half = n / 2;
+        std::thread left([this, docs, half, depth] { bisect(docs, half, depth + 1); });
+        bisect(docs + half, n - half, depth + 1);
+        left.join();
+    }
+
+    void bisect_serial(uint32_t* docs, size_t n) const {
+        Scratch scratch = make_scratch();
+        std::vector<std::pair<uint32_t*, size_t>> parts(1, std::make_pair(docs, n));
+        while (!parts.empty()) {
+            auto part = parts.back();
+            parts.pop_back();
+            if (part.second <= REORDER_MIN_PARTITION) continue;
+            split(part.first, part.second, scratch);
+            size_t half = part.second / 2;
+            parts.emplace_back(part.first + half, part.second - half);
+            parts.emplace_back(part.first, half);
+        }
+    }
+
+    // обмен документами между половинами [0, half) и [half, n)
+    void split(uint32_t* docs, size_t n, Scratch& s) const {
+        size_t half = n / 2;
+        for (size_t i = 0; i < n; ++i) {
+            std::vector<uint32_t>& deg = i < half ? s.left : s.right;
+            for (uint32_t t : doc_terms_[docs[i]]) ++deg[t];
+        }
+
+        for (int iter = 0; iter < REORDER_ITERATIONS; ++iter) {
+            s.left_gains.clear();
+            s.right_gains.clear();
+            for (size_t i = 0; i < half; ++i) {
+                s.left_gains.emplace_back(move_gain(doc_terms_[docs[i]], s.left, s.right, half, n - half), docs[i]);
+            }
+            for (size_t i = half; i < n; ++i) {
+                s.right_gains.emplace_back(move_gain(doc_terms_[docs[i]], s.right, s.left, n - half, half), docs[i]);
+            }
+            auto by_gain = [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) {
+                return a.first != b.first ? a.first > b.first : a.second < b.second;
+            };
+            std::sort(s.left_gains.begin(), s.left_gains.end(), by_gain);
+            std::sort(s.right_gains.begin(), s.right_gains.end(), by_gain);
+
+            // пары с наибольшим выигрышем меняются местами, пока обмен выгоден
+            size_t swaps = 0;
+            while (swaps < s.left_gains.size() && swaps < s.right_gains.size() &&
+                   s.left_gains[swaps].first + s.right_gains[swaps].first > 0.0f) {
+                uint32_t from_left = s.left_gains[swaps].second, from_right = s.right_gains[swaps].second;
+                for (uint32_t t : doc_terms_[from_left]) {
+                    --s.left[t];
+                    ++s.right[t];
+                }
+                for (uint32_t t : doc_terms_[from_right]) {
+                    --s.right[t];
+                    ++s.left[t];
+                }
+                s.left_gains[swaps].second = from_right;
+                s.right_gains[swaps].second = from_left;
+                ++swaps;
+            }
+            for (size_t i = 0; i < half; ++i) docs[i] = s.left_gains[i].second;
+            for (size_t i = half; i < n; ++i) docs[i] = s.right_gains[i - half].second;
+            if (swaps == 0) break;
+        }
+
+        // внутри половины порядок не важен для оценки; возрастание начального номера сохраняет порядок по ссылке
+        std::sort(docs, docs + half);
+        std::sort(docs + half, docs + n);
+        for (size_t i = 0; i < n; ++i) {
+            for (uint32_t t : doc_terms_[docs[i]]) s.left[t] = s.right[t] = 0;
+        }
+    }
+
+    const std::vector<std::vector<uint32_t>>& doc_terms_;
+    size_t term_count_;
+    std::vector<float> log2_;
+};
@@ -0,0 +1,184 @@
+// Локальное хранилище заголовков и ссылок (docstore.bin, пишет exporter.exe).
+//
+// Формат (little-endian):
+//   "DST1", uint32 flags (бит 0 - ссылки закодированы префиксами), uint32 max_doc_id, uint32 число префиксов
+//   префиксы: uint16 длина + байты
+//   смещения: uint32 offsets[max_doc_id + 2], запись doc_id - байты [offsets[id], offsets[id + 1]) кучи
+//   куча: запись = uint8 номер префикса (255 - без префикса), uint16 длина остатка ссылки, остаток ссылки, заголовок
+//
+// Файл отображается в память целиком, поиск записи - одно обращение к таблице смещений.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// файл, отображённый в память только для чтения
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+            close();
+            return false;
+        }
+        size_ = static_cast<size_t>(size.QuadPart);
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping_) {
+            close();
+            return false;
+        }
+        data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        data_ = (p == MAP_FAILED) ? nullptr : static_cast<const char*>(p);
+#endif
+        if (!data_) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (data_) UnmapViewOfFile(data_);
+        if (mapping_) CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+        mapping_ = nullptr;
+        file_ = INVALID_HANDLE_VALUE;
+#else
+        if (data_) munmap(const_cast<char*>(data_), size_);
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // заранее подтянуть страницы файла с диска (прогрев при запуске)
+    void prefetch() const {
+        if (!data_) return;
+#ifdef _WIN32
+        volatile char sink = 0;
+        for (size_t i = 0; i < size_; i += 4096) sink = sink ^ data_[i];
+#else
+        madvise(const_cast<char*>(data_), size_, MADV_WILLNEED);
+#endif
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#endif
+};
+
+class DocStore {
+public:
+    bool open(const std::string& path) {
+        if (!file_.open(path)) return false;
+        const char* p = file_.data();
+        size_t size = file_.size();
+        if (size < 16 || std::memcmp(p, "DST1", 4) != 0) return fail();
+
+        uint32_t flags, max_doc_id, prefix_count;
+        std::memcpy(&flags, p + 4, 4);
+        std::memcpy(&max_doc_id, p + 8, 4);
+        std::memcpy(&prefix_count, p + 12, 4);
+        size_t pos = 16;
+        for (uint32_t i = 0; i < prefix_count; ++i) {
+            if (pos + 2 > size) return fail();
+            uint16_t len;
+            std::memcpy(&len, p + pos, 2);
+            pos += 2;
+            if (pos + len > size) return fail();
+            prefixes_.emplace_back(p + pos, len);
+            pos += len;
+        }
+
+        doc_count_ = static_cast<size_t>(max_doc_id) + 1;
+        size_t table_size = (doc_count_ + 1) * 4;
+        if (pos + table_size > size) return fail();
+        offsets_ = p + pos;
+        heap_ = offsets_ + table_size;
+        heap_size_ = size - pos - table_size;
+        return offset(doc_count_) <= heap_size_ || fail();
+    }
+
+    bool is_open() const { return file_.data() != nullptr; }
+    size_t doc_count() const { return doc_count_; }
+    void prefetch() const { file_.prefetch(); }
+
+    bool lookup(int doc_id, std::string& url, std::string& title) const {
+        if (doc_id < 0 || static_cast<size_t>(doc_id) >= doc_count_) return false;
+        uint32_t begin = offset(doc_id), end = offset(doc_id + 1);
+        if (end <= begin || end > heap_size_ || end - begin < 3) return false;
+
+        const char* rec = heap_ + begin;
+        unsigned char prefix_id = static_cast<unsigned char>(rec[0]);
+        uint16_t url_len;
+        std::memcpy(&url_len, rec + 1, 2);
+        if (3u + url_len > end - begin) return false;
+
+        url.clear();
+        if (prefix_id < prefixes_.size()) url = prefixes_[prefix_id];
+        url.append(rec + 3, url_len);
+        title.assign(rec + 3 + url_len, end - begin - 3 - url_len);
+        return true;
+    }
+
+private:
+    uint32_t offset(size_t i) const {
+        uint32_t v;
+        std::memcpy(&v, offsets_ + i * 4, 4);
+        return v;
+    }
+
+    bool fail() {
+        file_.close();
+        prefixes_.clear();
+        doc_count_ = 0;
+        return false;
+    }
+
+    MappedFile file_;
+    std::vector<std::string> prefixes_;
+    size_t doc_count_ = 0;
+    const char* offsets_ = nullptr;
+    const char* heap_ = nullptr;
+    size_t heap_size_ = 0;
+};
@@ -0,0 +1,121 @@
+// Нечёткий поиск термина (searcher.exe): прикорм~1, прикорм~2.
+//
+// По слову запроса строится автомат Левенштейна: состояние - строка таблицы редакционного
+// расстояния между словом и уже прочитанным префиксом термина (значения больше k не различаются).
+// Автомат идёт по отсортированному словарю: у соседних терминов общий префикс, поэтому состояния
+// для него не пересчитываются, а для каждого символа префикса хранятся в стеке. Если после
+// какого-то символа из состояния уже не дойти до расстояния <= k, все термины с этим префиксом
+// пропускаются одним переходом lower_bound. Так просматриваются только префиксы в пределах k правок
+// от слова, а не все термины словаря. Расстояние считается по символам, а не по байтам UTF-8.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "term_dict.h"
+#include "wildcard.h"  // utf8_code_points, utf8_sequence_length
+
+const int FUZZY_MAX_DISTANCE = 2;
+
+class LevenshteinAutomaton {
+public:
+    LevenshteinAutomaton(const std::string& word, int max_distance)
+        : word_(utf8_code_points(word)), k_(static_cast<uint8_t>(max_distance)) {}
+
+    // длина состояния: строка таблицы расстояний по всем префиксам слова
+    size_t state_size() const { return word_.size() + 1; }
+
+    void start(uint8_t* state) const {
+        for (size_t i = 0; i < state_size(); ++i) state[i] = cap(i);
+    }
+
+    // переход по символу c; false - из нового состояния уже не дойти до совпадения
+    bool step(const uint8_t* state, uint32_t c, uint8_t* next) const {
+        next[0] = cap(state[0] + 1u);
+        uint8_t best = next[0];
+        for (size_t i = 1; i < state_size(); ++i) {
+            unsigned replace = state[i - 1] + (word_[i - 1] == c ? 0u : 1u);
+            unsigned insert = state[i] + 1u;
+            unsigned remove = next[i - 1] + 1u;
+            next[i] = cap(std::min(replace, std::min(insert, remove)));
+            best = std::min(best, next[i]);
+        }
+        return best <= k_;
+    }
+
+    // прочитанный префикс - термин в пределах k правок
+    bool is_match(const uint8_t* state) const { return state[word_.size()] <= k_; }
+
+private:
+    uint8_t cap(size_t value) const { return static_cast<uint8_t>(std::min<size_t>(value, k_ + 1u)); }
+
+    std::vector<uint32_t> word_;
+    uint8_t k_;
+};
+
+// сколько терминов с отброшенным префиксом пропускается подряд, прежде чем перейти через lower_bound:
+// маленькие поддеревья дешевле дочитать, чем искать их конец
+const size_t FUZZY_LINEAR_SKIP = 8;
+
+// номера терминов на расстоянии Левенштейна не больше max_distance от word, по возрастанию
+inline std::vector<uint32_t> expand_fuzzy(const TermDictionary& dict, const std::string& word, int max_distance) {
+    std::vector<uint32_t> result;
+    LevenshteinAutomaton automaton(word, max_distance);
+    const size_t width = automaton.state_size();
+    std::vector<uint8_t> states(width);       // states[d * width ...] - состояние после d символов
+    std::vector<size_t> ends(1, 0);           // ends[d] - байт, где кончается d-й символ префикса
+    automaton.start(states.data());
+    std::string prev;                         // термин, для которого посчитан стек
+    std::string dead;                         // префикс, с которым не подходит ни один термин
+    size_t skipped = 0;
+
+    TermDictionary::Cursor cursor(dict);
+    cursor.seek_index(0);
+    while (cursor.valid()) {
+        const std::string& term = cursor.term();
+        if (!dead.empty() && term.compare(0, dead.size(), dead) == 0) {
+            if (++skipped < FUZZY_LINEAR_SKIP) {
+                cursor.next();
+            } else {
+                // к первому термину после всех с этим префиксом
+                // (последний байт символа UTF-8 меньше 0xFF, увеличение не переполняется)
+                dead.back() = static_cast<char>(static_cast<unsigned char>(dead.back()) + 1);
+                cursor.seek(dead);
+                dead.clear();
+            }
+            continue;
+        }
+        dead.clear();
+        skipped = 0;
+
+        // символы общего с предыдущим термином префикса уже пройдены
+        size_t shared = 0;
+        size_t limit = std::min(prev.size(), term.size());
+        while (shared < limit && prev[shared] == term[shared]) ++shared;
+        size_t depth = 0;
+        while (depth + 1 < ends.size() && ends[depth + 1] <= shared) ++depth;
+        ends.resize(depth + 1);
+        prev = term;
+
+        bool alive = true;
+        for (size_t pos = ends[depth]; pos < term.size(); ++depth) {
+            size_t len = std::min(utf8_sequence_length(static_cast<unsigned char>(term[pos])), term.size() - pos);
+            uint32_t c = utf8_code_point(term, pos, len);
+            pos += len;
+            if (states.size() < (depth + 2) * width) states.resize((depth + 2) * width);
+            if (!automaton.step(&states[depth * width], c, &states[(depth + 1) * width])) {
+                dead = term.substr(0, pos);
+                prev.resize(pos - len);
+                alive = false;
+                break;
+            }
+            ends.push_back(pos);
+        }
+        if (alive && automaton.is_match(&states[depth * width])) result.push_back(static_cast<uint32_t>(cursor.index()));
+        cursor.next();
+    }
+    return result;
+}
@@ -1,17 +1,41 @@
-// g++ -std=c++17 -O2 indexer.cpp -o indexer.exe
-// .\indexer.exe
+// g++ -std=c++17 -O2 indexer.cpp -o indexer.exe -lpsapi
+// .\indexer.exe [--metrics metrics.jsonl]
+// .\indexer.exe --positions
+// .\indexer.exe --incremental [--positions]
+// .\indexer.exe --merge
+// .\indexer.exe --no-io-uring      (чтение stems/ пулом потоков вместо io_uring)
+// .\indexer.exe --reorder [--positions]   (новые doc_id: похожие документы подряд, doc_ids.txt - id в базе)
+// .\indexer.exe --drop-duplicates         (почти одинаковые документы из duplicates.txt не индексируются)
+// .\indexer.exe --shards 4 [--shard-by range|hash]   (shards/shard_<i> - независимые индексы, searcher.exe --coordinator)
 
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <string>
 #include <filesystem>
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include "segments.h"
+#include "suggest.h"
+#include "doc_reorder.h"
+#include "near_dup.h"
+#include "attributes.h"
+#include "shards.h"
+#include "docstore.h"
+#include "../common/metrics.h"
+#include "../common/file_batch.h"
+#include "../common/build_manifest.h"
 
 void setup_utf8_console() {
+#ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
     SetConsoleCP(CP_UTF8);
+#endif
 }
 
 // сортировка вставками
@@ -43,6 +67,57 @@ std::vector<std::string> remove_term_duplicates(const std::vector<std::string>&
     return unique;
 }
 
+// термины документа без дубликатов вместе с позициями каждого термина
+void group_term_positions(const std::vector<std::string>& stems,
+                          std::vector<std::string>& terms,
+                          std::vector<std::vector<int>>& positions) {
+    terms.clear();
+    positions.clear();
+    if (stems.empty()) return;
+
+    // устойчивая сортировка вставками номеров позиций по термину
+    std::vector<int> order(stems.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = static_cast<int>(i);
+    for (size_t i = 1; i < order.size(); ++i) {
+        int key = order[i];
+        size_t j = i;
+        while (j > 0 && stems[order[j - 1]] > stems[key]) {
+            order[j] = order[j - 1];
+            --j;
+        }
+        order[j] = key;
+    }
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        const std::string& term = stems[order[i]];
+        if (terms.empty() || terms.back() != term) {
+            terms.push_back(term);
+            positions.push_back({});
+        }
+        positions.back().push_back(order[i]);
+    }
+}
+
+// varint (LEB128)
+void append_varint(std::string& out, unsigned int value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// позиции термина в документе: первая абсолютно, далее разности
+std::string encode_positions(const std::vector<int>& positions) {
+    std::string out;
+    int prev = 0;
+    for (int p : positions) {
+        append_varint(out, static_cast<unsigned int>(p - prev));
+        prev = p;
+    }
+    return out;
+}
+
 // хэш-таблица
 struct SimpleHashTable {
     struct Entry {
@@ -102,7 +177,8 @@ struct SimpleHashTable {
 };
 
 // сортировка лексикографически
-void sort_terms_lex(std::vector<std::string>& terms, std::vector<std::vector<int>>& postings) {
+void sort_terms_lex(std::vector<std::string>& terms, std::vector<std::vector<int>>& postings,
+                    std::vector<std::vector<std::string>>* positions = nullptr) {
     size_t n = terms.size();
     for (size_t i = 0; i < n - 1; ++i) {
         size_t min_idx = i;
@@ -119,18 +195,54 @@ void sort_terms_lex(std::vector<std::string>& terms, std::vector<std::vector<int
             std::vector<int> temp_post = std::move(postings[i]);
             postings[i] = std::move(postings[min_idx]);
             postings[min_idx] = std::move(temp_post);
+
+            if (positions) {
+                std::vector<std::string> temp_pos = std::move((*positions)[i]);
+                (*positions)[i] = std::move((*positions)[min_idx]);
+                (*positions)[min_idx] = std::move(temp_pos);
+            }
         }
     }
 }
 
-std::vector<std::string> read_stems(const std::string& path) {
+// сортировка posting листа вместе с позициями, для повторного doc_id позиции берутся из первого вхождения
+void sort_postings_with_positions(std::vector<int>& list, std::vector<std::string>& positions) {
+    for (size_t idx = 1; idx < list.size(); ++idx) {
+        int key = list[idx];
+        std::string key_pos = std::move(positions[idx]);
+        size_t j = idx;
+        while (j > 0 && list[j - 1] > key) {
+            list[j] = list[j - 1];
+            positions[j] = std::move(positions[j - 1]);
+            --j;
+        }
+        list[j] = key;
+        positions[j] = std::move(key_pos);
+    }
+
+    std::vector<int> unique_list;
+    std::vector<std::string> unique_pos;
+    for (size_t k = 0; k < list.size(); ++k) {
+        if (k == 0 || list[k] != list[k - 1]) {
+            unique_list.push_back(list[k]);
+            unique_pos.push_back(std::move(positions[k]));
+        }
+    }
+    list = std::move(unique_list);
+    positions = std::move(unique_pos);
+}
+
+// стемы по строке
+std::vector<std::string> split_stems(const std::string& content) {
     std::vector<std::string> stems;
-    std::ifstream file(path, std::ios::binary);
-    if (!file.is_open()) return stems;
-    std::string line;
-    while (std::getline(file, line)) {
-        if (!line.empty() && line.back() == '\r') line.pop_back();
-        if (!line.empty()) stems.push_back(line);
+    size_t pos = 0;
+    while (pos < content.size()) {
+        size_t end = content.find('\n', pos);
+        if (end == std::string::npos) end = content.size();
+        size_t len = end - pos;
+        if (len > 0 && content[end - 1] == '\r') len--;
+        if (len > 0) stems.push_back(content.substr(pos, len));
+        pos = end + 1;
     }
     return stems;
 }
@@ -148,6 +260,766 @@ void write_index(const std::string& path, const std::vector<std::string>& terms,
     }
 }
 
+// positions.bin: "POS1", число терминов, таблица смещений блоков (терминов + 1), затем блоки.
+// Блок термина: для каждого документа из posting листа длина в байтах и закодированные позиции.
+void write_positions(const std::string& path, const std::vector<std::vector<std::string>>& positions) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) return;
+
+    uint64_t term_count = positions.size();
+    out.write("POS1", 4);
+    out.write(reinterpret_cast<const char*>(&term_count), sizeof(term_count));
+
+    std::vector<std::string> blocks(positions.size());
+    std::vector<uint64_t> offsets(positions.size() + 1, 0);
+    for (size_t i = 0; i < positions.size(); ++i) {
+        for (const auto& doc_pos : positions[i]) {
+            append_varint(blocks[i], static_cast<unsigned int>(doc_pos.size()));
+            blocks[i] += doc_pos;
+        }
+        offsets[i + 1] = offsets[i] + blocks[i].size();
+    }
+    out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+    for (const auto& block : blocks) {
+        out.write(block.data(), block.size());
+    }
+}
+
+// подсказки по префиксу (suggest.h): вес термина - число документов в его posting листе;
+// списки с запасом (SUGGEST_MERGE_K), чтобы searcher.exe мог слить подсказки сегментов
+void write_completion(const std::string& path, const std::vector<std::string>& terms, const std::vector<std::vector<int>>& postings) {
+    std::vector<uint32_t> weights;
+    weights.reserve(postings.size());
+    for (const auto& list : postings) weights.push_back(static_cast<uint32_t>(list.size()));
+    CompletionIndex completion;
+    completion.build(terms, weights, SUGGEST_MERGE_K);
+    if (!completion.write(path)) std::cerr << "Не удалось записать " << path << "\n";
+}
+
+// столбцы атрибутов документов индекса (attributes.h) из doc_attributes.txt от exporter.exe;
+// db_ids - id в базе по doc_id индекса (пусто - совпадают), segment - строки только для docs.
+// Без таблицы старый файл удаляется
+void write_attributes(const std::string& path, const DocAttributes& table, const std::vector<int>& docs,
+                      const std::vector<int>& db_ids, bool segment) {
+    std::error_code ec;
+    if (table.empty()) {
+        std::filesystem::remove(path, ec);
+        return;
+    }
+    DocAttributes attributes;
+    if (segment) {
+        attributes.select_rows(table, docs);
+    } else {
+        attributes.select(table, docs, db_ids);
+    }
+    if (!attributes.write(path)) std::cerr << "Не удалось записать " << path << "\n";
+}
+
+// varint из буфера, false если буфер закончился
+bool read_varint(const std::string& buf, size_t& pos, unsigned int& value) {
+    value = 0;
+    int shift = 0;
+    while (pos < buf.size() && shift < 35) {
+        unsigned char byte = static_cast<unsigned char>(buf[pos++]);
+        value |= static_cast<unsigned int>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+        shift += 7;
+    }
+    return false;
+}
+
+// построенный индекс: термины, posting листы, закодированные позиции (если есть), doc_id документов
+struct BuiltIndex {
+    std::vector<std::string> terms;
+    std::vector<std::vector<int>> postings;
+    std::vector<std::vector<std::string>> positions;
+    std::vector<int> docs;
+    std::vector<uint32_t> signatures;  // подписи MinHash документов docs подряд (near_dup.h)
+    bool with_positions = false;
+};
+
+// --incremental: манифест проиндексированных .stems и что о файлах известно со сканирования каталога
+struct IncrementalScan {
+    BuildManifest manifest;
+    std::vector<uint64_t> sizes;   // размер и время изменения на момент сканирования, по порядку files
+    std::vector<long long> times;
+    std::vector<int> emptied;      // прочитаны, но термов не осталось: старые копии удаляются из индекса
+    size_t unchanged = 0;          // файл перезаписан с тем же содержимым
+};
+
+// файлы читаются окном (file_batch.h), пока предыдущие документы индексируются
+void build_index(const std::vector<std::filesystem::path>& files, BuiltIndex& built, PipelineMetrics& metrics,
+                 bool use_io_uring, IncrementalScan* scan = nullptr) {
+    const bool with_positions = built.with_positions;
+    SimpleHashTable term_to_index(1048576);
+    size_t processed_docs = 0;
+
+    std::vector<std::string> paths;
+    for (const auto& path : files) paths.push_back(path.string());
+    FileBatchReader reader(std::move(paths), use_io_uring);
+    size_t file_index = 0;
+    std::string content;
+    bool read_ok = false;
+
+    while (true) {
+        {
+            PipelineMetrics::Phase phase(metrics, "read");
+            if (!reader.next(file_index, content, read_ok)) break;
+        }
+        metrics.set_queue_depth("read_window", reader.in_flight());
+        int doc_id = std::stoi(files[file_index].stem().string());
+        if (scan) {
+            // не прочитан - прежняя запись остаётся, время в ней старое, и файл перечитается в следующий раз
+            if (!read_ok) {
+                scan->manifest.keep(doc_id);
+                continue;
+            }
+            BuildManifest::State state = scan->manifest.update(doc_id, scan->sizes[file_index], content_hash(content),
+                                                               scan->times[file_index]);
+            if (state == BuildManifest::UNCHANGED) {
+                scan->unchanged++;
+                continue;
+            }
+        }
+
+        std::vector<std::string> stems = split_stems(content);
+        if (stems.empty()) {
+            if (scan) scan->emptied.push_back(doc_id);
+            continue;
+        }
+        built.docs.push_back(doc_id);
+        metrics.add_doc(content.size(), stems.size());
+        PipelineMetrics::Phase phase(metrics, "index");
+
+        std::vector<std::vector<int>> doc_positions;
+        if (with_positions) {
+            std::vector<std::string> doc_terms;
+            group_term_positions(stems, doc_terms, doc_positions);
+            stems = std::move(doc_terms);
+        } else {
+            stems = remove_term_duplicates(stems);
+        }
+        built.signatures.resize(built.docs.size() * MINHASH_SIZE);
+        minhash_signature(stems, &built.signatures[(built.docs.size() - 1) * MINHASH_SIZE]);
+
+        for (size_t t = 0; t < stems.size(); ++t) {
+            const std::string& term = stems[t];
+            size_t* idx_ptr = term_to_index.find(term);
+            size_t term_idx;
+            if (idx_ptr) {
+                term_idx = *idx_ptr;
+                built.postings[term_idx].push_back(doc_id);
+            } else {
+                term_idx = built.terms.size();
+                built.terms.push_back(term);
+                built.postings.push_back({doc_id});
+                term_to_index.insert(term, term_idx);
+                if (with_positions) built.positions.push_back({});
+            }
+            if (with_positions) {
+                built.positions[term_idx].push_back(encode_positions(doc_positions[t]));
+            }
+        }
+
+        processed_docs++;
+        if (processed_docs % 1000 == 0) {
+            std::cout << "Документов обработано: " << processed_docs << "\n";
+            metrics.emit("progress");
+        }
+    }
+
+    if (built.terms.empty()) return;
+    PipelineMetrics::Phase phase(metrics, "sort");
+
+    std::cout << "Сортировка терминов\n";
+    sort_terms_lex(built.terms, built.postings, with_positions ? &built.positions : nullptr);
+
+    std::cout << "Сортировка posting листов\n";
+    for (size_t i = 0; i < built.postings.size(); ++i) {
+        auto& list = built.postings[i];
+        if (list.size() <= 1) continue;
+
+        if (with_positions) {
+            sort_postings_with_positions(list, built.positions[i]);
+            continue;
+        }
+
+        for (size_t idx = 1; idx < list.size(); ++idx) {
+            int key = list[idx];
+            size_t j = idx;
+            while (j > 0 && list[j - 1] > key) {
+                list[j] = list[j - 1];
+                --j;
+            }
+            list[j] = key;
+        }
+
+        std::vector<int> unique_list;
+        unique_list.push_back(list[0]);
+        for (size_t k = 1; k < list.size(); ++k) {
+            if (list[k] != list[k - 1]) {
+                unique_list.push_back(list[k]);
+            }
+        }
+        list = std::move(unique_list);
+    }
+}
+
+// --drop-duplicates: документы, у которых есть более ранний почти одинаковый, убираются из индекса
+void drop_documents(BuiltIndex& built, const std::vector<std::pair<int, int>>& duplicates) {
+    std::vector<uint8_t> dropped;
+    for (const auto& d : duplicates) set_tombstone(dropped, d.first);
+
+    size_t kept_terms = 0;
+    for (size_t t = 0; t < built.terms.size(); ++t) {
+        std::vector<int> list;
+        std::vector<std::string> pos;
+        for (size_t k = 0; k < built.postings[t].size(); ++k) {
+            int id = built.postings[t][k];
+            if (is_tombstoned(dropped, id)) continue;
+            list.push_back(id);
+            if (built.with_positions) pos.push_back(std::move(built.positions[t][k]));
+        }
+        if (list.empty()) continue;
+        built.terms[kept_terms] = std::move(built.terms[t]);
+        built.postings[kept_terms] = std::move(list);
+        if (built.with_positions) built.positions[kept_terms] = std::move(pos);
+        ++kept_terms;
+    }
+    built.terms.resize(kept_terms);
+    built.postings.resize(kept_terms);
+    if (built.with_positions) built.positions.resize(kept_terms);
+
+    std::vector<int> docs;
+    for (int id : built.docs) {
+        if (!is_tombstoned(dropped, id)) docs.push_back(id);
+    }
+    built.docs = std::move(docs);
+}
+
+// перенумерация документов (doc_reorder.h): начальный порядок - по ссылкам из docstore.bin
+// (без него - по id в базе), затем деление пополам по терминам. Возвращает id в базе по новым номерам.
+std::vector<int> reorder_documents(BuiltIndex& built, const std::string& docstore_path) {
+    DocStore store;
+    bool with_urls = store.open(docstore_path);
+    std::vector<std::pair<std::string, int>> keyed;
+    std::string url, title;
+    for (int id : built.docs) {
+        bool found = with_urls && store.lookup(id, url, title);
+        keyed.emplace_back(found ? url_order_key(url) : std::string(), id);
+    }
+    std::sort(keyed.begin(), keyed.end());
+    std::cout << "Начальный порядок: " << (with_urls ? "по ссылкам из " + docstore_path : std::string("по id в базе"))
+              << "\n";
+
+    // rank_of[id в базе] - место документа в начальном порядке
+    int max_id = 0;
+    for (int id : built.docs) max_id = std::max(max_id, id);
+    std::vector<uint32_t> rank_of(static_cast<size_t>(max_id) + 1, 0);
+    for (size_t r = 0; r < keyed.size(); ++r) rank_of[keyed[r].second] = static_cast<uint32_t>(r);
+
+    // термины из одного документа на разности не влияют
+    std::vector<std::vector<uint32_t>> doc_terms(keyed.size());
+    for (size_t t = 0; t < built.postings.size(); ++t) {
+        if (built.postings[t].size() < 2) continue;
+        for (int id : built.postings[t]) doc_terms[rank_of[id]].push_back(static_cast<uint32_t>(t));
+    }
+    std::vector<uint32_t> order(keyed.size());
+    for (size_t r = 0; r < order.size(); ++r) order[r] = static_cast<uint32_t>(r);
+    GraphBisection(doc_terms, built.postings.size()).run(order);
+
+    std::vector<int> db_ids(order.size());
+    std::vector<int> new_id(rank_of.size(), 0);
+    for (size_t n = 0; n < order.size(); ++n) {
+        db_ids[n] = keyed[order[n]].second;
+        new_id[db_ids[n]] = static_cast<int>(n);
+    }
+
+    // posting листы в новых номерах, позиции переставляются вместе с ними
+    for (size_t t = 0; t < built.postings.size(); ++t) {
+        std::vector<int>& list = built.postings[t];
+        std::vector<std::pair<int, size_t>> items;
+        items.reserve(list.size());
+        for (size_t k = 0; k < list.size(); ++k) items.emplace_back(new_id[list[k]], k);
+        std::sort(items.begin(), items.end());
+        std::vector<std::string> pos;
+        for (size_t k = 0; k < items.size(); ++k) {
+            list[k] = items[k].first;
+            if (built.with_positions) pos.push_back(std::move(built.positions[t][items[k].second]));
+        }
+        if (built.with_positions) built.positions[t] = std::move(pos);
+    }
+    for (int& id : built.docs) id = new_id[id];
+    std::sort(built.docs.begin(), built.docs.end());
+    return db_ids;
+}
+
+// полный индекс в каталоге dir (рабочий каталог или каталог шарда). Файлы пишутся рядом с суффиксом .tmp
+// и подменяются переименованием (boolean_index.txt последним), как docstore.bin в exporter.exe:
+// загруженный снимок searcher.exe продолжает читать свою версию positions.bin, отображённую в память
+void write_full_index(const std::filesystem::path& dir, BuiltIndex& built, bool reorder, const std::string& docstore_path,
+                      const DocAttributes& attribute_table, PipelineMetrics& metrics) {
+    const std::string map_file = (dir / DOC_MAP_FILE).string();
+    std::vector<std::string> written;
+    auto tmp = [&written](const std::filesystem::path& path) {
+        written.push_back(path.string());
+        return path.string() + ".tmp";
+    };
+
+    std::vector<int> db_ids;
+    if (reorder && !built.docs.empty()) {
+        PipelineMetrics::Phase phase(metrics, "reorder");
+        std::cout << "Перенумерация документов\n";
+        size_t before = packed_postings_bytes(built.postings);
+        db_ids = reorder_documents(built, docstore_path);
+        size_t after = packed_postings_bytes(built.postings);
+        std::cout << "Posting листы (разности в varint): " << before / 1024 << " КБ -> " << after / 1024 << " КБ\n";
+        if (!write_doc_map(tmp(map_file), db_ids)) {
+            throw std::runtime_error("не удалось записать " + map_file);
+        }
+    }
+    if (!attribute_table.empty()) {
+        write_attributes(tmp(dir / "attributes.bin"), attribute_table, built.docs, db_ids, false);
+    }
+    std::cout << "Сохранение индекса\n";
+    PipelineMetrics::Phase phase(metrics, "write");
+    write_completion(tmp(dir / "suggest.bin"), built.terms, built.postings);
+    if (built.with_positions) {
+        std::cout << "Сохранение позиционного индекса\n";
+        write_positions(tmp(dir / "positions.bin"), built.positions);
+    }
+    write_index(tmp(dir / "boolean_index.txt"), built.terms, built.postings);
+
+    std::error_code ec;
+    if (db_ids.empty()) std::filesystem::remove(map_file, ec);
+    if (attribute_table.empty()) std::filesystem::remove(dir / "attributes.bin", ec);
+    for (const auto& path : written) {
+        std::filesystem::rename(path + ".tmp", path, ec);
+        if (ec) throw std::runtime_error("не удалось заменить " + path + ": " + ec.message());
+    }
+}
+
+// шарды (shards.h)
+
+// документы по шардам манифеста; термин попадает только в шарды, где есть его документы.
+// Позиции переносятся из built, posting листы built остаются для итоговой печати
+std::vector<BuiltIndex> split_shards(BuiltIndex& built, const ShardManifest& manifest) {
+    const size_t count = manifest.shards.size();
+    std::vector<BuiltIndex> parts(count);
+    for (auto& part : parts) part.with_positions = built.with_positions;
+
+    int max_id = 0;
+    for (int id : built.docs) max_id = std::max(max_id, id);
+    std::vector<uint32_t> shard(static_cast<size_t>(max_id) + 1, 0);
+    for (int id : built.docs) {
+        shard[id] = static_cast<uint32_t>(manifest.shard_of(id));
+        parts[shard[id]].docs.push_back(id);
+    }
+
+    std::vector<size_t> last_term(count, SIZE_MAX);
+    for (size_t t = 0; t < built.terms.size(); ++t) {
+        for (size_t k = 0; k < built.postings[t].size(); ++k) {
+            int id = built.postings[t][k];
+            BuiltIndex& part = parts[shard[id]];
+            if (last_term[shard[id]] != t) {
+                last_term[shard[id]] = t;
+                part.terms.push_back(built.terms[t]);
+                part.postings.emplace_back();
+                if (built.with_positions) part.positions.emplace_back();
+            }
+            part.postings.back().push_back(id);
+            if (built.with_positions) part.positions.back().push_back(std::move(built.positions[t][k]));
+        }
+    }
+    built.positions.clear();
+    return parts;
+}
+
+// --shards: каждый шард пишется полным индексом в shards/<имя>, затем манифест;
+// каталоги шардов, которых нет в новом манифесте, удаляются
+void write_shards(BuiltIndex& built, size_t count, bool by_hash, bool reorder, const std::string& docstore_path,
+                  const DocAttributes& attribute_table, PipelineMetrics& metrics) {
+    if (built.docs.size() < count) {
+        throw std::runtime_error("документов меньше, чем шардов");
+    }
+    ShardManifest manifest;
+    manifest.by_hash = by_hash;
+    manifest.shards.resize(count);
+    std::vector<int> sorted = built.docs;
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t s = 0; s < count; ++s) {
+        manifest.shards[s].name = "shard_" + std::to_string(s);
+        // поровну документов на шард; границы - первые id диапазонов
+        if (!by_hash) manifest.shards[s].first_id = sorted[s * sorted.size() / count];
+    }
+
+    std::vector<BuiltIndex> parts = split_shards(built, manifest);
+    std::filesystem::create_directories(SHARDS_DIR);
+    for (size_t s = 0; s < count; ++s) {
+        ShardInfo& info = manifest.shards[s];
+        BuiltIndex& part = parts[s];
+        info.doc_count = part.docs.size();
+        if (!part.docs.empty()) {
+            auto range = std::minmax_element(part.docs.begin(), part.docs.end());
+            info.first_id = *range.first;
+            info.last_id = *range.second;
+        }
+        std::filesystem::path dir = std::filesystem::path(SHARDS_DIR) / info.name;
+        std::filesystem::create_directories(dir);
+        std::cout << "Шард " << info.name << ": " << info.doc_count << " документов, " << part.terms.size()
+                  << " терминов\n";
+        write_full_index(dir, part, reorder, docstore_path, attribute_table, metrics);
+        part = BuiltIndex();
+    }
+    if (!write_shard_manifest(SHARDS_MANIFEST, manifest)) {
+        throw std::runtime_error("не удалось записать " + SHARDS_MANIFEST);
+    }
+
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(SHARDS_DIR)) {
+        std::string name = entry.path().filename().string();
+        if (!entry.is_directory() || name.rfind("shard_", 0) != 0) continue;
+        bool listed = std::any_of(manifest.shards.begin(), manifest.shards.end(),
+                                  [&name](const ShardInfo& info) { return info.name == name; });
+        if (!listed) std::filesystem::remove_all(entry.path(), ec);
+    }
+    std::cout << "Шардов: " << count << " (" << (by_hash ? "по хэшу id" : "по диапазонам id") << "), манифест "
+              << SHARDS_MANIFEST << "\n";
+}
+
+// сегменты
+
+// версия формата segments/indexed.txt (settings в BuildManifest)
+const uint64_t SOURCES_MANIFEST_VERSION = 1;
+
+std::string segment_path(const std::string& name, const std::string& ext) {
+    return SEGMENTS_DIR + "/" + name + ext;
+}
+
+void write_doc_list(const std::string& path, const std::vector<int>& docs) {
+    std::ofstream out(path);
+    for (int id : docs) out << id << "\n";
+}
+
+std::vector<int> read_doc_list(const std::string& path) {
+    std::vector<int> docs;
+    std::ifstream in(path);
+    int id;
+    while (in >> id) docs.push_back(id);
+    return docs;
+}
+
+void write_segment(const std::string& name, const BuiltIndex& built, const DocAttributes& attribute_table) {
+    write_index(segment_path(name, ".idx"), built.terms, built.postings);
+    write_doc_list(segment_path(name, ".docs"), built.docs);
+    write_completion(segment_path(name, ".sug"), built.terms, built.postings);
+    write_attributes(segment_path(name, ".attr"), attribute_table, built.docs, {}, true);
+    if (built.with_positions) {
+        write_positions(segment_path(name, ".pos"), built.positions);
+    }
+}
+
+// чтение сегмента целиком (для слияния); позиции - закодированными блоками по документам
+bool read_segment(const SegmentInfo& info, BuiltIndex& seg) {
+    std::ifstream in(segment_path(info.name, ".idx"));
+    if (!in.is_open()) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        seg.terms.push_back(line.substr(0, colon));
+        std::vector<int> docs;
+        size_t pos = colon + 1;
+        while (pos < line.size()) {
+            size_t comma = line.find(',', pos);
+            if (comma == std::string::npos) comma = line.size();
+            docs.push_back(std::stoi(line.substr(pos, comma - pos)));
+            pos = comma + 1;
+        }
+        seg.postings.push_back(std::move(docs));
+    }
+    seg.docs = read_doc_list(segment_path(info.name, ".docs"));
+
+    std::ifstream pos_in(segment_path(info.name, ".pos"), std::ios::binary);
+    if (!pos_in.is_open()) return true;
+
+    char magic[4];
+    uint64_t count = 0;
+    pos_in.read(magic, 4);
+    pos_in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!pos_in || std::string(magic, 4) != "POS1" || count != seg.terms.size()) return true;
+    std::vector<uint64_t> offsets(count + 1);
+    pos_in.read(reinterpret_cast<char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+    std::string data((std::istreambuf_iterator<char>(pos_in)), std::istreambuf_iterator<char>());
+    if (data.size() != offsets.back()) return true;
+
+    seg.positions.resize(count);
+    for (size_t t = 0; t < count; ++t) {
+        size_t pos = offsets[t];
+        for (size_t k = 0; k < seg.postings[t].size(); ++k) {
+            unsigned int len = 0;
+            if (!read_varint(data, pos, len) || pos + len > offsets[t + 1]) return true;
+            seg.positions[t].push_back(data.substr(pos, len));
+            pos += len;
+        }
+    }
+    seg.with_positions = true;
+    return true;
+}
+
+// помечает в старых сегментах документы, которые переиндексированы в новом (new_docs), остались
+// без термов (emptied) или пропали из stems (нет в битовой карте present). Возвращает число документов,
+// удалённых из индекса, - без переиндексированных
+size_t tombstone_documents(SegmentManifest& manifest, const std::vector<int>& new_docs,
+                           const std::vector<int>& emptied, const std::vector<uint8_t>& present) {
+    std::vector<uint8_t> fresh, gone, counted;
+    for (int id : new_docs) set_tombstone(fresh, id);
+    for (int id : emptied) set_tombstone(gone, id);
+
+    size_t removed = 0;
+    for (auto& seg : manifest.segments) {
+        std::vector<uint8_t> bitmap;
+        if (!seg.tombstones.empty()) bitmap = read_tombstones(SEGMENTS_DIR + "/" + seg.tombstones);
+        bool changed = false;
+        for (int id : read_doc_list(segment_path(seg.name, ".docs"))) {
+            if (is_tombstoned(bitmap, id)) continue;
+            bool reindexed = is_tombstoned(fresh, id);
+            if (!reindexed && !is_tombstoned(gone, id) && is_tombstoned(present, id)) continue;
+            set_tombstone(bitmap, id);
+            changed = true;
+            if (!reindexed && !is_tombstoned(counted, id)) {
+                set_tombstone(counted, id);
+                removed++;
+            }
+        }
+        if (!changed) continue;
+        std::string del_name = seg.name + "_" + std::to_string(manifest.generation + 1) + ".del";
+        write_tombstones(SEGMENTS_DIR + "/" + del_name, bitmap);
+        seg.tombstones = del_name;
+    }
+    return removed;
+}
+
+// слияние сегментов по порядку: удалённые документы отбрасываются, posting листы объединяются
+BuiltIndex merge_segments(const std::vector<SegmentInfo>& infos) {
+    BuiltIndex merged;
+    merged.with_positions = true;
+    for (size_t s = 0; s < infos.size(); ++s) {
+        BuiltIndex seg;
+        if (!read_segment(infos[s], seg)) {
+            throw std::runtime_error("не удалось прочитать сегмент " + infos[s].name);
+        }
+        std::vector<uint8_t> deleted;
+        if (!infos[s].tombstones.empty()) deleted = read_tombstones(SEGMENTS_DIR + "/" + infos[s].tombstones);
+        merged.with_positions = merged.with_positions && seg.with_positions;
+
+        for (int id : seg.docs) {
+            if (!is_tombstoned(deleted, id)) merged.docs.push_back(id);
+        }
+
+        BuiltIndex next;
+        next.with_positions = merged.with_positions;
+        size_t i = 0, j = 0;
+        while (i < merged.terms.size() || j < seg.terms.size()) {
+            bool take_left = j == seg.terms.size() || (i < merged.terms.size() && merged.terms[i] <= seg.terms[j]);
+            bool take_right = i == merged.terms.size() || (j < seg.terms.size() && seg.terms[j] <= merged.terms[i]);
+
+            std::vector<int> list;
+            std::vector<std::string> pos;
+            std::vector<int> right_list;
+            std::vector<std::string> right_pos;
+            if (take_left) {
+                list = std::move(merged.postings[i]);
+                if (next.with_positions) pos = std::move(merged.positions[i]);
+            }
+            if (take_right) {
+                for (size_t k = 0; k < seg.postings[j].size(); ++k) {
+                    int id = seg.postings[j][k];
+                    if (is_tombstoned(deleted, id)) continue;
+                    right_list.push_back(id);
+                    if (next.with_positions) right_pos.push_back(std::move(seg.positions[j][k]));
+                }
+            }
+
+            // слияние двух отсортированных листов с непересекающимися живыми doc_id
+            std::vector<int> out_list;
+            std::vector<std::string> out_pos;
+            size_t a = 0, b = 0;
+            while (a < list.size() || b < right_list.size()) {
+                if (b == right_list.size() || (a < list.size() && list[a] < right_list[b])) {
+                    out_list.push_back(list[a]);
+                    if (next.with_positions) out_pos.push_back(std::move(pos[a]));
+                    ++a;
+                } else {
+                    out_list.push_back(right_list[b]);
+                    if (next.with_positions) out_pos.push_back(std::move(right_pos[b]));
+                    ++b;
+                }
+            }
+
+            const std::string& term = take_left ? merged.terms[i] : seg.terms[j];
+            if (!out_list.empty()) {
+                next.terms.push_back(term);
+                next.postings.push_back(std::move(out_list));
+                if (next.with_positions) next.positions.push_back(std::move(out_pos));
+            }
+            if (take_left) ++i;
+            if (take_right) ++j;
+        }
+        next.docs = std::move(merged.docs);
+        merged = std::move(next);
+    }
+    if (!merged.with_positions) merged.positions.clear();
+    return merged;
+}
+
+// многоуровневая политика: сегменты делятся на уровни по числу документов
+// (уровень растёт в MERGE_FACTOR раз), уровень с MERGE_FACTOR сегментами сливается в один
+const size_t MERGE_FACTOR = 4;
+const size_t MIN_SEGMENT_DOCS = 1000;
+
+int segment_tier(size_t doc_count) {
+    int tier = 0;
+    size_t bound = MIN_SEGMENT_DOCS;
+    while (doc_count >= bound) {
+        bound *= MERGE_FACTOR;
+        ++tier;
+    }
+    return tier;
+}
+
+std::vector<size_t> pick_merge(const SegmentManifest& manifest) {
+    for (int tier = 0; tier < 32; ++tier) {
+        std::vector<size_t> candidates;
+        for (size_t i = 0; i < manifest.segments.size(); ++i) {
+            if (segment_tier(manifest.segments[i].doc_count) == tier) candidates.push_back(i);
+        }
+        if (candidates.size() >= MERGE_FACTOR) {
+            candidates.resize(MERGE_FACTOR);
+            return candidates;
+        }
+    }
+    return {};
+}
+
+void remove_segment_files(const SegmentInfo& info) {
+    std::error_code ec;
+    for (const char* ext : {".idx", ".docs", ".pos", ".sug", ".attr"}) {
+        std::filesystem::remove(segment_path(info.name, ext), ec);
+    }
+    if (!info.tombstones.empty()) std::filesystem::remove(SEGMENTS_DIR + "/" + info.tombstones, ec);
+}
+
+// документы слитых сегментов, удалённые уже после снимка манифеста (параллельным --incremental)
+std::vector<uint8_t> tombstoned_since(const std::vector<SegmentInfo>& snapshot, const SegmentManifest& current,
+                                      bool& changed) {
+    std::vector<uint8_t> bitmap;
+    changed = false;
+    for (const auto& old : snapshot) {
+        auto it = std::find_if(current.segments.begin(), current.segments.end(),
+                               [&](const SegmentInfo& s) { return s.name == old.name; });
+        if (it->tombstones == old.tombstones) continue;
+        std::vector<uint8_t> before, after;
+        if (!old.tombstones.empty()) before = read_tombstones(SEGMENTS_DIR + "/" + old.tombstones);
+        after = read_tombstones(SEGMENTS_DIR + "/" + it->tombstones);
+        for (int id : read_doc_list(segment_path(old.name, ".docs"))) {
+            if (is_tombstoned(after, id) && !is_tombstoned(before, id)) {
+                set_tombstone(bitmap, id);
+                changed = true;
+            }
+        }
+    }
+    return bitmap;
+}
+
+// блокировка берётся только на чтение и запись манифеста: само слияние идёт без неё,
+// поэтому --incremental может добавить сегмент и пометить удалённые документы во время слияния
+int run_merge(const std::string& attributes_table_file) {
+    DocAttributes attribute_table;
+    attribute_table.read_table(attributes_table_file);
+    int merges = 0;
+    bool locked = false;
+    try {
+        while (true) {
+            if (!lock_segments()) throw std::runtime_error("сегменты заняты другим процессом (" + SEGMENTS_LOCK + ")");
+            locked = true;
+            SegmentManifest manifest;
+            if (!read_manifest(SEGMENTS_MANIFEST, manifest)) break;
+            std::vector<size_t> picked = pick_merge(manifest);
+            if (picked.empty()) break;
+
+            std::vector<SegmentInfo> infos;
+            for (size_t idx : picked) infos.push_back(manifest.segments[idx]);
+            // имя резервируется сразу, чтобы параллельный --incremental не занял его
+            SegmentInfo out;
+            out.name = "seg_" + std::to_string(manifest.next_segment++);
+            if (!write_manifest(SEGMENTS_MANIFEST, manifest)) {
+                throw std::runtime_error("не удалось записать " + SEGMENTS_MANIFEST);
+            }
+            unlock_segments();
+            locked = false;
+
+            BuiltIndex merged = merge_segments(infos);
+            out.doc_count = merged.docs.size();
+            write_segment(out.name, merged, attribute_table);
+
+            if (!lock_segments()) throw std::runtime_error("сегменты заняты другим процессом (" + SEGMENTS_LOCK + ")");
+            locked = true;
+            if (!read_manifest(SEGMENTS_MANIFEST, manifest)) {
+                throw std::runtime_error("не удалось прочитать " + SEGMENTS_MANIFEST);
+            }
+            std::vector<size_t> current;
+            for (const auto& info : infos) {
+                for (size_t i = 0; i < manifest.segments.size(); ++i) {
+                    if (manifest.segments[i].name == info.name) current.push_back(i);
+                }
+            }
+            if (current.size() != infos.size()) {
+                remove_segment_files(out);
+                throw std::runtime_error("сегменты изменены другим процессом во время слияния");
+            }
+            bool changed = false;
+            std::vector<uint8_t> deleted = tombstoned_since(infos, manifest, changed);
+            if (changed) {
+                out.tombstones = out.name + "_" + std::to_string(manifest.generation + 1) + ".del";
+                write_tombstones(SEGMENTS_DIR + "/" + out.tombstones, deleted);
+            }
+
+            // новый сегмент встаёт на место первого из слитых, чтобы сохранить порядок по возрасту
+            std::vector<SegmentInfo> merged_from;
+            std::vector<SegmentInfo> segments;
+            for (size_t i = 0; i < manifest.segments.size(); ++i) {
+                if (i == current[0]) segments.push_back(out);
+                if (std::find(current.begin(), current.end(), i) == current.end()) {
+                    segments.push_back(manifest.segments[i]);
+                } else {
+                    merged_from.push_back(manifest.segments[i]);
+                }
+            }
+            manifest.segments = std::move(segments);
+            manifest.generation++;
+            if (!write_manifest(SEGMENTS_MANIFEST, manifest)) {
+                throw std::runtime_error("не удалось записать " + SEGMENTS_MANIFEST);
+            }
+            unlock_segments();
+            locked = false;
+            for (const auto& info : merged_from) remove_segment_files(info);
+            for (const auto& info : infos) remove_segment_files(info);
+
+            std::cout << "Слито сегментов: " << infos.size() << " -> " << out.name
+                      << " (" << out.doc_count << " документов)\n";
+            merges++;
+        }
+    } catch (const std::exception& e) {
+        if (locked) unlock_segments();
+        std::cerr << "Ошибка: " << e.what() << "\n";
+        return 1;
+    }
+    if (locked) unlock_segments();
+    std::cout << "Слияний выполнено: " << merges << "\n";
+    return 0;
+}
+
 void validate_index(const std::vector<std::string>& terms, const std::vector<std::vector<int>>& postings, size_t sample_count = 10) {
     if (terms.empty()) {
         std::cout << "Индекс пуст.\n";
@@ -168,86 +1040,169 @@ void validate_index(const std::vector<std::string>& terms, const std::vector<std
     std::cout << "\n";
 }
 
-int main() {
+int main(int argc, char* argv[]) {
     setup_utf8_console();
 
+    bool with_positions = false;
+    bool incremental = false;
+    bool merge_only = false;
+    bool use_io_uring = true;
+    bool reorder = false;
+    bool drop_duplicates = false;
+    size_t shard_count = 0;
+    bool shard_by_hash = false;
+    std::string metrics_path;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--metrics" && i + 1 < argc) {
+            metrics_path = argv[++i];
+        } else if (arg == "--positions") {
+            with_positions = true;
+        } else if (arg == "--incremental") {
+            incremental = true;
+        } else if (arg == "--merge") {
+            merge_only = true;
+        } else if (arg == "--no-io-uring") {
+            use_io_uring = false;
+        } else if (arg == "--reorder") {
+            reorder = true;
+        } else if (arg == "--drop-duplicates") {
+            drop_duplicates = true;
+        } else if (arg == "--shards" && i + 1 < argc) {
+            shard_count = static_cast<size_t>(std::stoi(argv[++i]));
+        } else if (arg == "--shard-by" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode != "range" && mode != "hash") return 1;
+            shard_by_hash = mode == "hash";
+        } else {
+            return 1;
+        }
+    }
+
+    // источник и дата документов по id в базе (exporter.exe пишет рядом с docstore.bin)
+    const std::string attributes_table_file = "doc_attributes.txt";
+    if (merge_only) {
+        return run_merge(attributes_table_file);
+    }
+    if ((reorder || drop_duplicates) && incremental) {
+        // тумбстоуны и .docs сегментов хранят id из базы, почти одинаковые ищутся по всему корпусу
+        std::cerr << "--reorder и --drop-duplicates работают только при полной индексации\n";
+        return 1;
+    }
+    if (shard_count > 0 && incremental) {
+        std::cerr << "--shards работает только при полной индексации\n";
+        return 1;
+    }
+
     const std::string input_dir = "../preprocessor/stems";
-    const std::string output_file = "boolean_index.txt";
+    const std::string docstore_file = "docstore.bin";
 
     if (!std::filesystem::exists(input_dir)) {
         std::cerr << "Папка stems не найдена\n";
         return 1;
     }
 
-    std::vector<std::string> all_terms;
-    std::vector<std::vector<int>> all_postings;
-    SimpleHashTable term_to_index(1048576);
+    SegmentManifest manifest;
+    IncrementalScan scan;
+    if (incremental) {
+        std::filesystem::create_directories(SEGMENTS_DIR);
+        scan.manifest.load(SEGMENTS_SOURCES, SOURCES_MANIFEST_VERSION);
+    }
+
+    DocAttributes attribute_table;
+    if (attribute_table.read_table(attributes_table_file)) {
+        std::cout << "Атрибуты документов: " << attributes_table_file << "\n";
+    }
+
+    BuiltIndex built;
+    built.with_positions = with_positions;
+    PipelineMetrics metrics("indexer", metrics_path);
 
     auto start = std::chrono::high_resolution_clock::now();
+    bool locked = false;
 
     try {
-        size_t processed_docs = 0;
-
+        // в инкрементальном режиме берутся только .stems, чьи размер или время изменения не совпали
+        // с манифестом; present - все doc_id в stems, документы сегментов вне него удаляются
+        std::vector<std::filesystem::path> files;
+        std::vector<uint8_t> present;
+        size_t skipped = 0;
         for (const auto& entry : std::filesystem::directory_iterator(input_dir)) {
             if (entry.path().extension() != ".stems") continue;
-
-            std::string stem_name = entry.path().stem().string();
-            int doc_id = std::stoi(stem_name);
-
-            auto stems = read_stems(entry.path().string());
-            if (stems.empty()) continue;
-
-            stems = remove_term_duplicates(stems);
-
-            for (const auto& term : stems) {
-                size_t* idx_ptr = term_to_index.find(term);
-                if (idx_ptr) {
-                    all_postings[*idx_ptr].push_back(doc_id);
-                } else {
-                    size_t new_idx = all_terms.size();
-                    all_terms.push_back(term);
-                    all_postings.push_back({doc_id});
-                    term_to_index.insert(term, new_idx);
+            if (incremental) {
+                int doc_id = std::stoi(entry.path().stem().string());
+                set_tombstone(present, doc_id);
+                uint64_t size = entry.file_size();
+                long long mtime = file_time_value(entry.path());
+                if (scan.manifest.same_source(doc_id, size, mtime)) {
+                    skipped++;
+                    continue;
                 }
+                scan.sizes.push_back(size);
+                scan.times.push_back(mtime);
             }
-
-            processed_docs++;
-            if (processed_docs % 1000 == 0) {
-                std::cout << "Документов обработано: " << processed_docs << "\n";
-            }
+            files.push_back(entry.path());
         }
 
-        std::cout << "Сортировка терминов\n";
-        sort_terms_lex(all_terms, all_postings);
+        build_index(files, built, metrics, use_io_uring, incremental ? &scan : nullptr);
+        const auto& all_terms = built.terms;
+        const auto& all_postings = built.postings;
+        size_t processed_docs = built.docs.size();
 
-        std::cout << "Сортировка posting листов\n";
-        for (size_t i = 0; i < all_postings.size(); ++i) {
-            auto& list = all_postings[i];
-            if (list.size() <= 1) continue;
-
-            for (size_t idx = 1; idx < list.size(); ++idx) {
-                int key = list[idx];
-                size_t j = idx;
-                while (j > 0 && list[j - 1] > key) {
-                    list[j] = list[j - 1];
-                    --j;
-                }
-                list[j] = key;
+        if (incremental) {
+            // сегмент строится без блокировки; манифест перечитывается под ней, т.к. его мог изменить --merge
+            if (!lock_segments()) throw std::runtime_error("сегменты заняты другим процессом (" + SEGMENTS_LOCK + ")");
+            locked = true;
+            read_manifest(SEGMENTS_MANIFEST, manifest);
+            size_t removed = tombstone_documents(manifest, built.docs, scan.emptied, present);
+            if (!built.docs.empty()) {
+                SegmentInfo info;
+                info.name = "seg_" + std::to_string(manifest.next_segment++);
+                info.doc_count = built.docs.size();
+                std::cout << "Сохранение сегмента " << info.name << "\n";
+                PipelineMetrics::Phase phase(metrics, "write");
+                write_segment(info.name, built, attribute_table);
+                manifest.segments.push_back(info);
             }
-
-            std::vector<int> unique_list;
-            unique_list.push_back(list[0]);
-            for (size_t k = 1; k < list.size(); ++k) {
-                if (list[k] != list[k - 1]) {
-                    unique_list.push_back(list[k]);
+            manifest.generation++;
+            if (!write_manifest(SEGMENTS_MANIFEST, manifest)) {
+                throw std::runtime_error("не удалось записать " + SEGMENTS_MANIFEST);
+            }
+            // после segments.txt: при сбое между ними документы просто переиндексируются ещё раз
+            scan.manifest.take_unseen();
+            if (!scan.manifest.save(SEGMENTS_SOURCES)) {
+                throw std::runtime_error("не удалось записать " + SEGMENTS_SOURCES);
+            }
+            unlock_segments();
+            locked = false;
+            std::cout << "Пропущено неизменённых документов: " << skipped + scan.unchanged << "\n";
+            std::cout << "Удалено из индекса документов: " << removed << "\n";
+            std::cout << "Сегментов в индексе: " << manifest.segments.size()
+                      << " (слияние: indexer.exe --merge)\n";
+        } else {
+            {
+                PipelineMetrics::Phase phase(metrics, "dedup");
+                std::vector<std::pair<int, int>> duplicates = find_near_duplicates(built.signatures, built.docs);
+                std::vector<int> clusters;
+                for (const auto& d : duplicates) clusters.push_back(d.second);
+                std::sort(clusters.begin(), clusters.end());
+                clusters.erase(std::unique(clusters.begin(), clusters.end()), clusters.end());
+                std::cout << "Почти одинаковых документов: " << duplicates.size() << " (кластеров: " << clusters.size() << ")\n";
+                if (!DuplicateTable::write(DUPLICATES_FILE, duplicates)) {
+                    throw std::runtime_error("не удалось записать " + DUPLICATES_FILE);
+                }
+                if (drop_duplicates && !duplicates.empty()) {
+                    drop_documents(built, duplicates);
+                    std::cout << "Не индексируются: " << duplicates.size() << " документов\n";
                 }
             }
-            list = std::move(unique_list);
+            if (shard_count > 0) {
+                write_shards(built, shard_count, shard_by_hash, reorder, docstore_file, attribute_table, metrics);
+            } else {
+                write_full_index(".", built, reorder, docstore_file, attribute_table, metrics);
+            }
         }
 
-        std::cout << "Сохранение индекса\n";
-        write_index(output_file, all_terms, all_postings);
-
         auto end = std::chrono::high_resolution_clock::now();
         double elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
 
@@ -255,12 +1210,14 @@ int main() {
         std::cout << "Всего терминов: " << all_terms.size() << "\n";
         std::cout << "Документов обработано: " << processed_docs << "\n";
         std::cout << "Время выполнения: " << elapsed << " сек\n";
+        metrics.emit("summary");
         validate_index(all_terms, all_postings, 10);
 
     } catch (const std::exception& e) {
+        if (locked) unlock_segments();
         std::cerr << "Ошибка: " << e.what() << "\n";
         return 1;
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,129 @@
+// g++ -std=c++17 -O2 loadgen.cpp -o loadgen.exe -lws2_32
+// .\loadgen.exe queries.txt [--port 8765] [--connections 8] [--requests 10000]
+
+// нагрузочный клиент для searcher.exe --serve: каждое соединение шлёт запросы из файла
+// по кругу и ждёт ответ (замкнутый цикл), в конце печатаются QPS и перцентили задержки
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include "net.h"
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+void setup_utf8_console() {
+#ifdef _WIN32
+    SetConsoleOutputCP(CP_UTF8);
+    SetConsoleCP(CP_UTF8);
+#endif
+}
+
+std::vector<std::string> read_queries(const std::string& path) {
+    std::vector<std::string> queries;
+    std::ifstream file(path, std::ios::binary);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) queries.push_back(line);
+    }
+    return queries;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t idx = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[idx];
+}
+
+int main(int argc, char* argv[]) {
+    setup_utf8_console();
+
+    if (argc < 2) {
+        std::cerr << "Использование: loadgen.exe queries.txt [--port N] [--connections N] [--requests N]\n";
+        return 1;
+    }
+    std::string queries_path = argv[1];
+    int port = DEFAULT_SERVE_PORT;
+    size_t connections = 8;
+    size_t total_requests = 10000;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) {
+            port = std::stoi(argv[++i]);
+        } else if (arg == "--connections" && i + 1 < argc) {
+            connections = static_cast<size_t>(std::stoi(argv[++i]));
+        } else if (arg == "--requests" && i + 1 < argc) {
+            total_requests = static_cast<size_t>(std::stoull(argv[++i]));
+        } else {
+            return 1;
+        }
+    }
+
+    auto queries = read_queries(queries_path);
+    if (queries.empty()) {
+        std::cerr << "Файл запросов пуст: " << queries_path << "\n";
+        return 1;
+    }
+    if (!net_init()) return 1;
+
+    std::vector<std::vector<double>> latencies(connections);
+    std::atomic<size_t> next_request{0};
+    std::atomic<size_t> errors{0};
+    std::atomic<size_t> partial{0};  // PARTIAL от searcher.exe --coordinator
+    std::atomic<size_t> failed_connections{0};
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c < connections; ++c) {
+        threads.emplace_back([&, c] {
+            socket_t s = connect_tcp("127.0.0.1", port);
+            if (s == INVALID_SOCK) {
+                failed_connections++;
+                return;
+            }
+            LineReader reader(s);
+            std::string response;
+            while (true) {
+                size_t n = next_request++;
+                if (n >= total_requests) break;
+                auto t0 = std::chrono::steady_clock::now();
+                if (!send_all(s, queries[n % queries.size()] + "\n") || !reader.read_line(response)) {
+                    errors++;
+                    break;
+                }
+                auto t1 = std::chrono::steady_clock::now();
+                if (response.compare(0, 8, "PARTIAL ") == 0) {
+                    partial++;
+                } else if (response.compare(0, 3, "OK ") != 0) {
+                    errors++;
+                }
+                latencies[c].push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+            }
+            close_socket(s);
+        });
+    }
+    for (auto& t : threads) t.join();
+    auto end = std::chrono::steady_clock::now();
+
+    std::vector<double> all;
+    for (const auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+    double elapsed = std::chrono::duration<double>(end - start).count();
+
+    if (failed_connections > 0) {
+        std::cerr << "Не удалось подключиться: " << failed_connections << " соединений\n";
+    }
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Запросов выполнено: " << all.size() << " (ошибок: " << errors << ", неполных ответов: " << partial << ")\n";
+    std::cout << "Соединений: " << connections << ", время: " << elapsed << " сек\n";
+    std::cout << "QPS: " << (elapsed > 0 ? all.size() / elapsed : 0.0) << "\n";
+    std::cout << "Задержка p50: " << percentile(all, 0.50) << " мкс, p99: " << percentile(all, 0.99) << " мкс\n";
+    return all.empty() ? 1 : 0;
+}
@@ -0,0 +1,146 @@
+// Почти одинаковые документы (indexer.exe пишет duplicates.txt, searcher.exe --collapse-duplicates).
+//
+// Сайты перепечатывают статьи друг у друга. Для каждого документа по множеству его стемов считается
+// подпись MinHash: MINHASH_SIZE минимумов хэшей стемов с разными затравками; доля совпавших
+// минимумов двух подписей - оценка коэффициента Жаккара множеств. Чтобы не сравнивать все пары,
+// подпись режется на LSH_BANDS полос: документы, у которых совпала хотя бы одна полоса целиком,
+// становятся кандидатами, и только они сравниваются по всей подписи. Пары с оценкой не ниже
+// DUPLICATE_SIMILARITY объединяются в кластеры.
+//
+// duplicates.txt - по строке на документ, у которого есть более ранний почти одинаковый:
+//   <id документа> <id представителя кластера - наименьший id в кластере>
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+const std::string DUPLICATES_FILE = "duplicates.txt";
+
+const size_t MINHASH_SIZE = 64;
+const size_t LSH_BANDS = 16;  // по 4 минимума в полосе: пара с Жаккаром 0.8 становится кандидатом с вероятностью > 0.999
+const double DUPLICATE_SIMILARITY = 0.8;
+
+inline uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+inline uint64_t stem_hash(const std::string& s) {
+    uint64_t h = 14695981039346656037ull;
+    for (char c : s) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// подпись документа по его стемам без повторов: out[0..MINHASH_SIZE)
+inline void minhash_signature(const std::vector<std::string>& terms, uint32_t* out) {
+    std::fill(out, out + MINHASH_SIZE, UINT32_MAX);
+    for (const auto& term : terms) {
+        uint64_t h = stem_hash(term);
+        for (size_t i = 0; i < MINHASH_SIZE; ++i) {
+            uint32_t v = static_cast<uint32_t>(mix64(h ^ (i * 0x632BE59BD9B4E019ull)));
+            if (v < out[i]) out[i] = v;
+        }
+    }
+}
+
+inline double signature_similarity(const uint32_t* a, const uint32_t* b) {
+    size_t same = 0;
+    for (size_t i = 0; i < MINHASH_SIZE; ++i) same += a[i] == b[i];
+    return static_cast<double>(same) / MINHASH_SIZE;
+}
+
+// signatures - подписи документов ids подряд. Возвращает пары (id, представитель) по возрастанию id
+inline std::vector<std::pair<int, int>> find_near_duplicates(const std::vector<uint32_t>& signatures,
+                                                             const std::vector<int>& ids) {
+    const size_t n = ids.size();
+    const size_t rows = MINHASH_SIZE / LSH_BANDS;
+    std::vector<size_t> parent(n);
+    for (size_t i = 0; i < n; ++i) parent[i] = i;
+    auto root = [&parent](size_t x) {
+        while (parent[x] != x) x = parent[x] = parent[parent[x]];
+        return x;
+    };
+    auto sig = [&signatures](size_t d) { return signatures.data() + d * MINHASH_SIZE; };
+    auto link = [&](size_t a, size_t b) {
+        if (root(a) == root(b)) return true;
+        if (signature_similarity(sig(a), sig(b)) < DUPLICATE_SIMILARITY) return false;
+        parent[root(a)] = root(b);
+        return true;
+    };
+
+    std::vector<std::pair<uint64_t, uint32_t>> buckets(n);
+    for (size_t band = 0; band < LSH_BANDS; ++band) {
+        for (size_t d = 0; d < n; ++d) {
+            uint64_t key = band;
+            for (size_t r = 0; r < rows; ++r) key = mix64(key ^ sig(d)[band * rows + r]);
+            buckets[d] = std::make_pair(key, static_cast<uint32_t>(d));
+        }
+        std::sort(buckets.begin(), buckets.end());
+        // в корзине документ сравнивается с первым и с предыдущим, а не со всеми:
+        // корзина из одинаковых коротких документов не даёт квадратичного числа сравнений
+        size_t first = 0;
+        for (size_t i = 1; i < n; ++i) {
+            if (buckets[i].first != buckets[i - 1].first) {
+                first = i;
+                continue;
+            }
+            if (!link(buckets[first].second, buckets[i].second) && first != i - 1) {
+                link(buckets[i - 1].second, buckets[i].second);
+            }
+        }
+    }
+
+    std::vector<int> smallest(n, 0);
+    for (size_t d = 0; d < n; ++d) smallest[d] = ids[d];
+    for (size_t d = 0; d < n; ++d) smallest[root(d)] = std::min(smallest[root(d)], ids[d]);
+    std::vector<std::pair<int, int>> result;
+    for (size_t d = 0; d < n; ++d) {
+        int rep = smallest[root(d)];
+        if (rep != ids[d]) result.emplace_back(ids[d], rep);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+// таблица кластеров в памяти searcher.exe
+class DuplicateTable {
+public:
+    bool load(const std::string& path) {
+        entries_.clear();
+        std::ifstream in(path);
+        if (!in.is_open()) return false;
+        int id, rep;
+        while (in >> id >> rep) entries_.emplace_back(id, rep);
+        std::sort(entries_.begin(), entries_.end());
+        return true;
+    }
+
+    static bool write(const std::string& path, const std::vector<std::pair<int, int>>& entries) {
+        std::ofstream out(path);
+        if (!out.is_open()) return false;
+        for (const auto& e : entries) out << e.first << " " << e.second << "\n";
+        return static_cast<bool>(out);
+    }
+
+    bool empty() const { return entries_.empty(); }
+    size_t size() const { return entries_.size(); }
+
+    // представитель кластера документа (сам документ, если почти одинаковых у него нет)
+    int representative(int id) const {
+        auto it = std::lower_bound(entries_.begin(), entries_.end(), std::make_pair(id, INT32_MIN));
+        return it != entries_.end() && it->first == id ? it->second : id;
+    }
+
+private:
+    std::vector<std::pair<int, int>> entries_;
+};
@@ -0,0 +1,176 @@
+// Сокеты для searcher.exe --serve и loadgen.exe: Winsock на Windows, POSIX на Linux.
+// Протокол построчный: клиент шлёт запрос строкой, сервер отвечает одной строкой
+//   OK <число документов> <id> <id> ...
+//   ERR <сообщение>
+//   PARTIAL <число документов> <id> ...   (searcher.exe --coordinator: ответили не все шарды)
+//   SUGGEST <число> <термин>:<документов> ...   (на "suggest <префикс>" - до 10 терминов,
+//                                               на "suggest/<k> <префикс>" - до k, k не больше 40)
+
+#pragma once
+
+#include <string>
+#include <cstring>
+
+#ifdef _WIN32
+#if !defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0600
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600  // WSAPoll
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+const socket_t INVALID_SOCK = INVALID_SOCKET;
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <cerrno>
+typedef int socket_t;
+const socket_t INVALID_SOCK = -1;
+#endif
+
+// запись в сокет, закрытый другой стороной, не должна убивать процесс сигналом SIGPIPE
+#if defined(MSG_NOSIGNAL)
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+const int DEFAULT_SERVE_PORT = 8765;
+
+inline bool net_init() {
+#ifdef _WIN32
+    WSADATA data;
+    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+    return true;
+#endif
+}
+
+inline void close_socket(socket_t s) {
+#ifdef _WIN32
+    closesocket(s);
+#else
+    close(s);
+#endif
+}
+
+inline bool set_nonblocking(socket_t s) {
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(s, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(s, F_GETFL, 0);
+    return flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+inline bool last_error_would_block() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+inline int poll_sockets(pollfd* fds, size_t count, int timeout_ms) {
+#ifdef _WIN32
+    return WSAPoll(fds, static_cast<ULONG>(count), timeout_ms);
+#else
+    return poll(fds, count, timeout_ms);
+#endif
+}
+
+inline void set_nodelay(socket_t s) {
+    int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+}
+
+// отправка целиком; для неблокирующего сокета ждёт готовности к записи
+inline bool send_all(socket_t s, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        int n = send(s, data.data() + sent, static_cast<int>(data.size() - sent), SEND_FLAGS);
+        if (n > 0) {
+            sent += static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && last_error_would_block()) {
+            pollfd pfd{};
+            pfd.fd = s;
+            pfd.events = POLLOUT;
+            if (poll_sockets(&pfd, 1, 5000) <= 0) return false;
+            continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+inline socket_t listen_tcp(int port) {
+    socket_t s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == INVALID_SOCK) return INVALID_SOCK;
+    int one = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&one), sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<unsigned short>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(s, 128) != 0) {
+        close_socket(s);
+        return INVALID_SOCK;
+    }
+    return s;
+}
+
+inline socket_t connect_tcp(const std::string& host, int port) {
+    socket_t s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == INVALID_SOCK) return INVALID_SOCK;
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<unsigned short>(port));
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 ||
+        connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close_socket(s);
+        return INVALID_SOCK;
+    }
+    set_nodelay(s);
+    return s;
+}
+
+// построчное чтение из блокирующего сокета
+class LineReader {
+public:
+    explicit LineReader(socket_t s) : sock_(s) {}
+
+    bool read_line(std::string& line) {
+        while (true) {
+            size_t nl = buffer_.find('\n', start_);
+            if (nl != std::string::npos) {
+                line = buffer_.substr(start_, nl - start_);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                start_ = nl + 1;
+                if (start_ == buffer_.size()) {
+                    buffer_.clear();
+                    start_ = 0;
+                }
+                return true;
+            }
+            char chunk[4096];
+            int n = recv(sock_, chunk, sizeof(chunk), 0);
+            if (n <= 0) return false;
+            buffer_.append(chunk, static_cast<size_t>(n));
+        }
+    }
+
+private:
+    socket_t sock_;
+    std::string buffer_;
+    size_t start_ = 0;
+};
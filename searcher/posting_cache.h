@@ -0,0 +1,156 @@
+// Кэш раскодированных posting листов частых терминов (searcher.exe).
+//
+// В памяти индекса posting листы хранятся сжатыми (разности doc_id в varint), и каждый запрос
+// с термином раскодировал бы его лист заново. Кэш держит раскодированные листы в пределах
+// бюджета в байтах. Вытеснение - LRU, но новый лист допускается в кэш, только если по частотной
+// оценке (TinyLFU: count-min sketch со старением) к нему обращаются чаще, чем к вытесняемым.
+// Поэтому разовые запросы по редким терминам не выталкивают горячие термины.
+
+#pragma once
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+
+typedef std::shared_ptr<const std::vector<int>> PostingList;
+
+struct PostingCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t rejected = 0;   // не допущены фильтром частоты
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t capacity = 0;
+};
+
+class PostingCache {
+public:
+    explicit PostingCache(size_t capacity_bytes = 0) { set_capacity(capacity_bytes); }
+
+    // вызывается до начала поиска
+    void set_capacity(size_t capacity_bytes) {
+        std::lock_guard<std::mutex> guard(lock_);
+        capacity_ = capacity_bytes;
+        // ширина скетча - примерно по счётчику на каждые 256 байт бюджета, степень двойки
+        size_t width = 1024;
+        while (width < capacity_bytes / 256 && width < (size_t(1) << 24)) width <<= 1;
+        sketch_.assign(SKETCH_ROWS * width, 0);
+        sketch_mask_ = width - 1;
+        sample_limit_ = width * 10;
+        samples_ = 0;
+    }
+
+    bool enabled() const { return capacity_ > 0; }
+
+    PostingList get(uint64_t key) {
+        std::lock_guard<std::mutex> guard(lock_);
+        record(key);
+        auto it = map_.find(key);
+        if (it == map_.end()) {
+            ++misses_;
+            return nullptr;
+        }
+        ++hits_;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return it->second->list;
+    }
+
+    void put(uint64_t key, PostingList list) {
+        size_t size = entry_size(*list);
+        std::lock_guard<std::mutex> guard(lock_);
+        if (size > capacity_ || map_.count(key)) return;
+
+        // кандидат должен быть частотнее каждого, кого вытесняет
+        unsigned candidate = estimate(key);
+        size_t freed = 0;
+        auto victim = lru_.end();
+        while (bytes_ - freed + size > capacity_ && victim != lru_.begin()) {
+            --victim;
+            if (estimate(victim->key) >= candidate) {
+                ++rejected_;
+                return;
+            }
+            freed += entry_size(*victim->list);
+        }
+        while (bytes_ + size > capacity_) {
+            bytes_ -= entry_size(*lru_.back().list);
+            map_.erase(lru_.back().key);
+            lru_.pop_back();
+            ++evictions_;
+        }
+        lru_.push_front({key, std::move(list)});
+        map_[key] = lru_.begin();
+        bytes_ += size;
+    }
+
+    PostingCacheStats stats() const {
+        std::lock_guard<std::mutex> guard(lock_);
+        PostingCacheStats s;
+        s.hits = hits_;
+        s.misses = misses_;
+        s.rejected = rejected_;
+        s.evictions = evictions_;
+        s.entries = lru_.size();
+        s.bytes = bytes_;
+        s.capacity = capacity_;
+        return s;
+    }
+
+private:
+    static const size_t SKETCH_ROWS = 4;
+    static const uint8_t SKETCH_MAX = 15;
+
+    struct Entry {
+        uint64_t key;
+        PostingList list;
+    };
+
+    static size_t entry_size(const std::vector<int>& list) { return list.size() * sizeof(int) + 64; }
+
+    size_t slot(uint64_t key, size_t row) const {
+        uint64_t h = key * 0x9E3779B97F4A7C15ull + (row + 1) * 0xD6E8FEB86659FD93ull;
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 32;
+        return row * (sketch_mask_ + 1) + (h & sketch_mask_);
+    }
+
+    void record(uint64_t key) {
+        for (size_t row = 0; row < SKETCH_ROWS; ++row) {
+            uint8_t& c = sketch_[slot(key, row)];
+            if (c < SKETCH_MAX) ++c;
+        }
+        // старение: раз в sample_limit_ обращений счётчики делятся пополам
+        if (++samples_ >= sample_limit_) {
+            for (auto& c : sketch_) c >>= 1;
+            samples_ /= 2;
+        }
+    }
+
+    unsigned estimate(uint64_t key) const {
+        unsigned result = SKETCH_MAX;
+        for (size_t row = 0; row < SKETCH_ROWS; ++row) {
+            result = std::min<unsigned>(result, sketch_[slot(key, row)]);
+        }
+        return result;
+    }
+
+    size_t capacity_ = 0;
+    mutable std::mutex lock_;
+    std::list<Entry> lru_;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> map_;
+    size_t bytes_ = 0;
+    std::vector<uint8_t> sketch_;
+    size_t sketch_mask_ = 0;
+    size_t sample_limit_ = 0;
+    size_t samples_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t rejected_ = 0;
+    uint64_t evictions_ = 0;
+};
@@ -0,0 +1,206 @@
+// Posting листы в памяти searcher.exe: операции над отсортированными списками doc_id
+// и загрузка boolean_index.txt. Вынесено из searcher.cpp, чтобы те же функции
+// собирались в bench/microbench.cpp без PostgreSQL и сокетов.
+
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <utility>
+
+#include "term_dict.h"
+
+// поиск
+
+inline std::vector<int> intersect_lists(const std::vector<int>& a, const std::vector<int>& b) {
+    std::vector<int> result;
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (a[i] == b[j]) {
+            result.push_back(a[i]);
+            ++i; ++j;
+        } else if (a[i] < b[j]) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+    return result;
+}
+
+inline std::vector<int> union_lists(const std::vector<int>& a, const std::vector<int>& b) {
+    std::vector<int> result;
+    size_t i = 0, j = 0;
+    while (i < a.size() || j < b.size()) {
+        if (j == b.size() || (i < a.size() && a[i] < b[j])) {
+            result.push_back(a[i++]);
+        } else if (i == a.size() || (j < b.size() && b[j] < a[i])) {
+            result.push_back(b[j++]);
+        } else {
+            result.push_back(a[i++]);
+            ++j;
+        }
+    }
+
+    std::vector<int> unique;
+    for (size_t k = 0; k < result.size(); ++k) {
+        if (k == 0 || result[k] != result[k - 1]) {
+            unique.push_back(result[k]);
+        }
+    }
+    return unique;
+}
+
+inline std::vector<int> difference_lists(const std::vector<int>& a, const std::vector<int>& b) {
+    std::vector<int> result;
+    size_t i = 0, j = 0;
+    while (i < a.size()) {
+        if (j < b.size() && b[j] < a[i]) {
+            ++j;
+        } else if (j < b.size() && b[j] == a[i]) {
+            ++i; ++j;
+        } else {
+            result.push_back(a[i++]);
+        }
+    }
+    return result;
+}
+
+// объединение многих списков сразу (термины шаблона), каждый элемент просматривается один раз,
+// а не при каждом попарном объединении. Немного списков - слияние через кучу по текущим головам;
+// много списков с плотными doc_id - битовая карта: отметить все элементы и собрать отмеченные
+inline std::vector<int> union_many(const std::vector<const std::vector<int>*>& lists) {
+    if (lists.empty()) return {};
+    if (lists.size() == 1) return *lists[0];
+    size_t total = 0;
+    int max_doc = 0;
+    for (const auto* list : lists) {
+        total += list->size();
+        if (!list->empty()) max_doc = std::max(max_doc, list->back());
+    }
+    if (lists.size() > 8 && static_cast<size_t>(max_doc) / 64 <= total) {
+        std::vector<uint64_t> bits(static_cast<size_t>(max_doc) / 64 + 1, 0);
+        for (const auto* list : lists) {
+            for (int id : *list) bits[static_cast<size_t>(id) >> 6] |= uint64_t(1) << (id & 63);
+        }
+        std::vector<int> result;
+        result.reserve(total);
+        for (size_t w = 0; w < bits.size(); ++w) {
+            for (uint64_t word = bits[w]; word != 0; word &= word - 1) {
+                result.push_back(static_cast<int>(w * 64 + __builtin_ctzll(word)));
+            }
+        }
+        return result;
+    }
+
+    typedef std::pair<int, size_t> Head;  // значение, номер списка
+    std::vector<Head> heap;
+    std::vector<size_t> pos(lists.size(), 0);
+    for (size_t i = 0; i < lists.size(); ++i) {
+        if (!lists[i]->empty()) heap.emplace_back((*lists[i])[0], i);
+    }
+    auto greater = [](const Head& a, const Head& b) { return a.first > b.first; };
+    std::make_heap(heap.begin(), heap.end(), greater);
+
+    std::vector<int> result;
+    result.reserve(total);
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), greater);
+        Head head = heap.back();
+        heap.pop_back();
+        if (result.empty() || result.back() != head.first) result.push_back(head.first);
+        const std::vector<int>& list = *lists[head.second];
+        if (++pos[head.second] < list.size()) {
+            heap.emplace_back(list[pos[head.second]], head.second);
+            std::push_heap(heap.begin(), heap.end(), greater);
+        }
+    }
+    return result;
+}
+
+// загрузка индекса
+
+// posting лист хранится в памяти сжатым: разности соседних doc_id в varint
+struct IndexEntry {
+    std::string packed;
+    uint32_t doc_count = 0;
+};
+
+// термины в сжатом словаре, posting листы - по номеру термина
+struct TermIndex {
+    TermDictionary terms;
+    std::vector<IndexEntry> postings;
+
+    size_t size() const { return postings.size(); }
+};
+
+inline void append_varint(std::string& out, unsigned int value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+inline bool read_varint(const std::string& buf, size_t& pos, unsigned int& value) {
+    value = 0;
+    int shift = 0;
+    while (pos < buf.size() && shift < 35) {
+        unsigned char byte = static_cast<unsigned char>(buf[pos++]);
+        value |= static_cast<unsigned int>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+        shift += 7;
+    }
+    return false;
+}
+
+inline std::vector<int> unpack_postings(const IndexEntry& entry) {
+    std::vector<int> docs;
+    docs.reserve(entry.doc_count);
+    size_t pos = 0;
+    unsigned int prev = 0, delta = 0;
+    while (pos < entry.packed.size() && read_varint(entry.packed, pos, delta)) {
+        prev += delta;
+        docs.push_back(static_cast<int>(prev));
+    }
+    return docs;
+}
+
+inline bool load_index(const std::string& path, TermIndex& index) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        std::cerr << "Файл индекса не найден: " << path << "\n";
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        size_t pos = line.find(':');
+        if (pos == std::string::npos) continue;
+        std::string rest = line.substr(pos + 1);
+
+        IndexEntry entry;
+        std::stringstream ss(rest);
+        std::string id_str;
+        unsigned int prev = 0;
+        while (std::getline(ss, id_str, ',')) {
+            if (!id_str.empty()) {
+                unsigned int id = static_cast<unsigned int>(std::stoi(id_str));
+                append_varint(entry.packed, id - prev);
+                prev = id;
+                ++entry.doc_count;
+            }
+        }
+        entry.packed.shrink_to_fit();
+        index.terms.add(line.substr(0, pos));
+        index.postings.push_back(std::move(entry));
+    }
+    index.terms.finish();
+    index.postings.shrink_to_fit();
+    return true;
+}
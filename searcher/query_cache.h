@@ -0,0 +1,148 @@
+// Кэш результатов запросов (searcher.exe, интерактивный режим и --serve).
+//
+// Ключ - каноническая запись дерева запроса (см. canonical_query в searcher.cpp), поэтому
+// "a and b" и "b and a" попадают в одну запись. Значение - отсортированный список doc_id,
+// сжатый разностями в varint (обычно 1-2 байта на документ вместо 4).
+// Объём ограничен в байтах, вытесняется давно не использованная запись (LRU).
+// Каждая запись помнит версию индекса; при смене версии кэш очищается целиком.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+struct QueryCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t capacity = 0;
+};
+
+class QueryCache {
+public:
+    explicit QueryCache(size_t capacity_bytes) : capacity_(capacity_bytes) {}
+
+    bool enabled() const { return capacity_ > 0; }
+
+    bool get(const std::string& key, const std::string& version, std::vector<int>& docs) {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (version != version_) {
+            clear_locked(version);
+        }
+        auto it = map_.find(key);
+        if (it == map_.end()) {
+            ++misses_;
+            return false;
+        }
+        ++hits_;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        decode(it->second->packed, it->second->count, docs);
+        return true;
+    }
+
+    void put(const std::string& key, const std::string& version, const std::vector<int>& docs) {
+        Entry entry{key, encode(docs), docs.size()};
+        size_t size = entry_size(entry);
+        std::lock_guard<std::mutex> guard(lock_);
+        if (version != version_) {
+            clear_locked(version);
+        }
+        if (size > capacity_) return;
+
+        auto it = map_.find(key);
+        if (it != map_.end()) {
+            bytes_ -= entry_size(*it->second);
+            lru_.erase(it->second);
+            map_.erase(it);
+        }
+        while (bytes_ + size > capacity_ && !lru_.empty()) {
+            bytes_ -= entry_size(lru_.back());
+            map_.erase(lru_.back().key);
+            lru_.pop_back();
+            ++evictions_;
+        }
+        lru_.push_front(std::move(entry));
+        map_[key] = lru_.begin();
+        bytes_ += size;
+    }
+
+    QueryCacheStats stats() const {
+        std::lock_guard<std::mutex> guard(lock_);
+        QueryCacheStats s;
+        s.hits = hits_;
+        s.misses = misses_;
+        s.evictions = evictions_;
+        s.entries = lru_.size();
+        s.bytes = bytes_;
+        s.capacity = capacity_;
+        return s;
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        std::string packed;
+        size_t count;
+    };
+
+    // ключ хранится дважды (в списке и в хеш-таблице), плюс примерные накладные расходы узлов
+    static size_t entry_size(const Entry& e) { return 2 * e.key.size() + e.packed.size() + 96; }
+
+    static std::string encode(const std::vector<int>& docs) {
+        std::string out;
+        out.reserve(docs.size() * 2);
+        unsigned int prev = 0;
+        for (int id : docs) {
+            unsigned int delta = static_cast<unsigned int>(id) - prev;
+            prev = static_cast<unsigned int>(id);
+            while (delta >= 0x80) {
+                out += static_cast<char>((delta & 0x7F) | 0x80);
+                delta >>= 7;
+            }
+            out += static_cast<char>(delta);
+        }
+        return out;
+    }
+
+    static void decode(const std::string& packed, size_t count, std::vector<int>& docs) {
+        docs.clear();
+        docs.reserve(count);
+        unsigned int prev = 0, value = 0;
+        int shift = 0;
+        for (char c : packed) {
+            unsigned char byte = static_cast<unsigned char>(c);
+            value |= static_cast<unsigned int>(byte & 0x7F) << shift;
+            if (byte & 0x80) {
+                shift += 7;
+                continue;
+            }
+            prev += value;
+            docs.push_back(static_cast<int>(prev));
+            value = 0;
+            shift = 0;
+        }
+    }
+
+    void clear_locked(const std::string& version) {
+        lru_.clear();
+        map_.clear();
+        bytes_ = 0;
+        version_ = version;
+    }
+
+    size_t capacity_;
+    mutable std::mutex lock_;
+    std::string version_;
+    std::list<Entry> lru_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> map_;
+    size_t bytes_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t evictions_ = 0;
+};
@@ -0,0 +1,115 @@
+// Журнал частых терминов запросов для прогрева индекса при запуске (searcher.exe --warmup <файл>).
+//
+// Файл - строки "<вес> <термин>" по убыванию веса, не больше QUERY_LOG_TERMS строк.
+// При сохранении прошлые веса делятся пополам, к ним прибавляются обращения с прошлого
+// сохранения, - так в начале файла оказываются термины, которые ищут часто и недавно.
+// Сохраняется раз в QUERY_LOG_SAVE_INTERVAL и при завершении, через временный файл.
+
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <filesystem>
+
+const size_t QUERY_LOG_TERMS = 1000;
+const std::chrono::seconds QUERY_LOG_SAVE_INTERVAL(60);
+
+class QueryTermLog {
+public:
+    ~QueryTermLog() { stop(); }
+
+    // читает прошлый журнал и запускает периодическое сохранение
+    void start(const std::string& path) {
+        path_ = path;
+        std::ifstream in(path);
+        double weight;
+        std::string term;
+        while (in >> weight >> term) {
+            saved_.emplace_back(term, weight);
+        }
+        enabled_ = true;
+        thread_ = std::thread([this] { run(); });
+    }
+
+    bool enabled() const { return enabled_; }
+
+    // термины прошлого журнала, самые частые первыми
+    std::vector<std::string> top_terms() const {
+        std::lock_guard<std::mutex> guard(lock_);
+        std::vector<std::string> terms;
+        for (const auto& t : saved_) terms.push_back(t.first);
+        return terms;
+    }
+
+    void record(const std::vector<std::string>& terms) {
+        if (!enabled_) return;
+        std::lock_guard<std::mutex> guard(lock_);
+        for (const auto& t : terms) ++counts_[t];
+    }
+
+    void stop() {
+        if (!thread_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        thread_.join();
+        save();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> guard(lock_);
+        while (!wake_.wait_for(guard, QUERY_LOG_SAVE_INTERVAL, [this] { return stop_; })) {
+            guard.unlock();
+            save();
+            guard.lock();
+        }
+    }
+
+    void save() {
+        std::unordered_map<std::string, double> weights;
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            if (counts_.empty()) return;
+            for (const auto& t : saved_) weights[t.first] += t.second / 2;
+            for (const auto& c : counts_) weights[c.first] += c.second;
+            counts_.clear();
+        }
+
+        std::vector<std::pair<std::string, double>> ranked(weights.begin(), weights.end());
+        std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+        if (ranked.size() > QUERY_LOG_TERMS) ranked.resize(QUERY_LOG_TERMS);
+
+        std::string tmp = path_ + ".tmp";
+        {
+            std::ofstream out(tmp);
+            if (!out.is_open()) return;
+            for (const auto& t : ranked) out << t.second << " " << t.first << "\n";
+            if (!out) return;
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, path_, ec);
+        std::lock_guard<std::mutex> guard(lock_);
+        saved_ = std::move(ranked);
+    }
+
+    std::string path_;
+    bool enabled_ = false;
+    std::vector<std::pair<std::string, double>> saved_;
+    std::unordered_map<std::string, unsigned> counts_;
+    mutable std::mutex lock_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    std::thread thread_;
+};
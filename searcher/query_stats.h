@@ -0,0 +1,207 @@
+// Время этапов запроса (searcher.exe --stats).
+//
+// Каждый поток пишет в свои гистограммы (атомарные счётчики, без блокировок), команда stats
+// складывает гистограммы всех потоков. Гистограмма логарифмически-линейная, как HDR:
+// на каждую степень двойки наносекунд 16 корзин, погрешность перцентиля не больше ~6%.
+// Без --stats таймеры не читают часы, остаётся одна проверка флага.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <cstdint>
+
+enum QueryStage {
+    STAGE_PARSE,
+    STAGE_LOOKUP,
+    STAGE_POSTINGS,
+    STAGE_SET_OPS,
+    STAGE_METADATA,
+    STAGE_OUTPUT,
+    STAGE_COUNT
+};
+
+const char* const STAGE_NAMES[STAGE_COUNT] = {"parse", "lookup", "postings", "set_ops", "metadata", "output"};
+
+const int HISTOGRAM_SUB_BITS = 4;
+const size_t HISTOGRAM_BUCKETS = (64 - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS;
+
+inline size_t histogram_bucket(uint64_t ns) {
+    if (ns < (1u << HISTOGRAM_SUB_BITS)) return static_cast<size_t>(ns);
+    int exponent = 63;
+    while (!(ns >> exponent)) --exponent;
+    int shift = exponent - HISTOGRAM_SUB_BITS;
+    size_t sub = static_cast<size_t>(ns >> shift) & ((1u << HISTOGRAM_SUB_BITS) - 1);
+    return (static_cast<size_t>(shift + 1) << HISTOGRAM_SUB_BITS) + sub;
+}
+
+// нижняя граница значений корзины
+inline uint64_t histogram_value(size_t bucket) {
+    size_t group = bucket >> HISTOGRAM_SUB_BITS;
+    uint64_t sub = bucket & ((1u << HISTOGRAM_SUB_BITS) - 1);
+    if (group == 0) return sub;
+    return (sub | (1u << HISTOGRAM_SUB_BITS)) << (group - 1);
+}
+
+// счётчики одного потока; пишет только владелец, читает команда stats
+struct ThreadStats {
+    std::atomic<uint64_t> buckets[STAGE_COUNT][HISTOGRAM_BUCKETS] = {};
+    std::atomic<uint64_t> postings_scanned{0};
+    std::atomic<uint64_t> bytes_decoded{0};
+    std::atomic<uint64_t> queries{0};
+};
+
+class QueryStats {
+public:
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed) && !paused(); }
+    void enable() { enabled_ = true; }
+
+    // поток, занятый не запросами (прогрев), на время паузы ничего не записывает
+    static bool& paused() {
+        thread_local bool value = false;
+        return value;
+    }
+
+    ThreadStats& local() {
+        thread_local ThreadStats* stats = nullptr;
+        if (!stats) {
+            auto owned = std::make_shared<ThreadStats>();
+            stats = owned.get();
+            std::lock_guard<std::mutex> guard(lock_);
+            threads_.push_back(std::move(owned));
+        }
+        return *stats;
+    }
+
+    void record(QueryStage stage, uint64_t ns) {
+        local().buckets[stage][histogram_bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void add_postings(uint64_t count) {
+        if (enabled()) local().postings_scanned.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void add_bytes(uint64_t count) {
+        if (enabled()) local().bytes_decoded.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void add_query() {
+        if (enabled()) local().queries.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // по строке на этап и строка счётчиков
+    std::vector<std::string> report() const {
+        std::vector<std::vector<uint64_t>> merged(STAGE_COUNT, std::vector<uint64_t>(HISTOGRAM_BUCKETS, 0));
+        uint64_t postings = 0, bytes = 0, queries = 0;
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            for (const auto& t : threads_) {
+                for (size_t s = 0; s < STAGE_COUNT; ++s) {
+                    for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+                        merged[s][b] += t->buckets[s][b].load(std::memory_order_relaxed);
+                    }
+                }
+                postings += t->postings_scanned.load(std::memory_order_relaxed);
+                bytes += t->bytes_decoded.load(std::memory_order_relaxed);
+                queries += t->queries.load(std::memory_order_relaxed);
+            }
+        }
+
+        std::vector<std::string> lines;
+        for (size_t s = 0; s < STAGE_COUNT; ++s) {
+            uint64_t count = 0;
+            for (uint64_t c : merged[s]) count += c;
+            std::ostringstream out;
+            out << std::fixed << std::setprecision(1) << STAGE_NAMES[s] << " count=" << count;
+            if (count > 0) {
+                out << " p50=" << percentile(merged[s], count, 0.50) / 1000.0 << "us"
+                    << " p90=" << percentile(merged[s], count, 0.90) / 1000.0 << "us"
+                    << " p99=" << percentile(merged[s], count, 0.99) / 1000.0 << "us";
+            }
+            lines.push_back(out.str());
+        }
+        lines.push_back("queries=" + std::to_string(queries) + " postings_scanned=" + std::to_string(postings) +
+                        " bytes_decoded=" + std::to_string(bytes));
+        return lines;
+    }
+
+private:
+    static uint64_t percentile(const std::vector<uint64_t>& buckets, uint64_t count, double p) {
+        uint64_t rank = static_cast<uint64_t>(p * (count - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t b = 0; b < buckets.size(); ++b) {
+            seen += buckets[b];
+            if (seen >= rank) return histogram_value(b);
+        }
+        return 0;
+    }
+
+    std::atomic<bool> enabled_{false};
+    mutable std::mutex lock_;
+    std::vector<std::shared_ptr<ThreadStats>> threads_;
+};
+
+// пауза записи в текущем потоке до конца области видимости
+class StatsPause {
+public:
+    StatsPause() : previous_(QueryStats::paused()) { QueryStats::paused() = true; }
+    ~StatsPause() { QueryStats::paused() = previous_; }
+    StatsPause(const StatsPause&) = delete;
+    StatsPause& operator=(const StatsPause&) = delete;
+
+private:
+    bool previous_;
+};
+
+// время от создания до конца области видимости записывается в этап stage
+class StageTimer {
+public:
+    StageTimer(QueryStats& stats, QueryStage stage) : stats_(stats), stage_(stage), active_(stats.enabled()) {
+        if (active_) start_ = std::chrono::steady_clock::now();
+    }
+    ~StageTimer() {
+        if (!active_) return;
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+        stats_.record(stage_, static_cast<uint64_t>(ns.count()));
+    }
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    QueryStats& stats_;
+    QueryStage stage_;
+    bool active_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// этап, который идёт кусками вперемешку с другими: сумма кусков записывается одним замером
+class StageClock {
+public:
+    StageClock(QueryStats& stats, QueryStage stage) : stats_(stats), stage_(stage), active_(stats.enabled()) {}
+    ~StageClock() {
+        if (!active_) return;
+        stats_.record(stage_, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(total_).count()));
+    }
+    StageClock(const StageClock&) = delete;
+    StageClock& operator=(const StageClock&) = delete;
+
+    void start() {
+        if (active_) start_ = std::chrono::steady_clock::now();
+    }
+    void stop() {
+        if (active_) total_ += std::chrono::steady_clock::now() - start_;
+    }
+
+private:
+    QueryStats& stats_;
+    QueryStage stage_;
+    bool active_;
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::duration total_{0};
+};
@@ -1,11 +1,20 @@
 // g++ -std=c++17 -O2 searcher.cpp `
 //    -I"C:\Program Files\PostgreSQL\16\include" `
 //    -L"C:\Program Files\PostgreSQL\16\lib" `
-//    -lpq `
+//    -lpq -lws2_32 `
 //    -o searcher.exe
 
 // .\searcher.exe
 // .\searcher.exe --ids-only 
+// .\searcher.exe --page-size 20
+// .\searcher.exe --serve [--port 8765] [--threads N]
+// .\searcher.exe --cache-mb 64 --postings-cache-mb 256   (0 - без кэша)
+// .\searcher.exe --warmup query_terms.txt
+// .\searcher.exe --stats            (время этапов запроса, команда stats)
+// .\searcher.exe --max-expansion 1000   (терминов на шаблон с * или term~k, 0 - без ограничения)
+// .\searcher.exe --collapse-duplicates  (из почти одинаковых документов duplicates.txt - только первый)
+// .\searcher.exe --coordinator [--shard 127.0.0.1:8766 ...] [--shard-timeout-ms 1000] [--port 8765]
+// .\searcher.exe --bench queries.txt [--threads N] [--requests N] [--rate QPS]
 
 #include <iostream>
 #include <fstream>
@@ -13,119 +22,218 @@
 #include <string>
 #include <sstream>
 #include <cctype>
+#include <cstdint>
+#include <cstring>
+#include "net.h"
+#ifdef _WIN32
 #include <windows.h>
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 #include <libpq-fe.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <deque>
+#include <map>
+#include <unordered_set>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <iomanip>
+#include "segments.h"
+#include "postings.h"
+#include "wildcard.h"
+#include "fuzzy.h"
+#include "suggest.h"
+#include "doc_reorder.h"
+#include "near_dup.h"
+#include "attributes.h"
+#include "shards.h"
+#include "coordinator.h"
+#include "docstore.h"
+#include "query_cache.h"
+#include "posting_cache.h"
+#include "query_log.h"
+#include "query_stats.h"
 
 void setup_utf8_console() {
+#ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
     SetConsoleCP(CP_UTF8);
+#endif
 }
 
-// поиск
+// время этапов запроса и счётчики (--stats, команда stats)
+QueryStats query_stats;
 
-std::vector<int> intersect_lists(const std::vector<int>& a, const std::vector<int>& b) {
-    std::vector<int> result;
-    size_t i = 0, j = 0;
-    while (i < a.size() && j < b.size()) {
-        if (a[i] == b[j]) {
-            result.push_back(a[i]);
-            ++i; ++j;
-        } else if (a[i] < b[j]) {
-            ++i;
-        } else {
-            ++j;
-        }
-    }
-    return result;
+// поиск термина в словаре сегмента (бинарный поиск по блокам, см. term_dict.h)
+
+long long find_term(const TermIndex& index, const std::string& term) {
+    StageTimer timer(query_stats, STAGE_LOOKUP);
+    return index.terms.find(term);
 }
 
-std::vector<int> union_lists(const std::vector<int>& a, const std::vector<int>& b) {
-    std::vector<int> result;
-    size_t i = 0, j = 0;
-    while (i < a.size() || j < b.size()) {
-        if (j == b.size() || (i < a.size() && a[i] < b[j])) {
-            result.push_back(a[i++]);
-        } else if (i == a.size() || (j < b.size() && b[j] < a[i])) {
-            result.push_back(b[j++]);
-        } else {
-            result.push_back(a[i++]);
-            ++j;
-        }
+// позиционный индекс (positions.bin от indexer.exe --positions)
+// в памяти только таблица смещений, блоки читаются с диска для фразовых и NEAR запросов.
+// Файл остаётся открытым, пока жива версия индекса, - так старая версия читает свои позиции
+// даже после того, как --merge удалил сегмент.
+
+// positions.bin отображается в память: снимок держит свою версию файла, даже если indexer.exe
+// уже подменил его новой (запись через .tmp и переименование)
+struct PositionIndex {
+    std::shared_ptr<MappedFile> file;
+    std::vector<uint64_t> offsets;
+    uint64_t data_start = 0;
+
+    bool available() const { return !offsets.empty(); }
+};
+
+void load_positions(const std::string& path, size_t term_count, PositionIndex& positions) {
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(path)) return;
+
+    const uint64_t header = 4 + sizeof(uint64_t);
+    uint64_t count = 0;
+    if (file->size() >= header) std::memcpy(&count, file->data() + 4, sizeof(count));
+    if (file->size() < header || std::string(file->data(), 4) != "POS1" || count != term_count) {
+        std::cerr << "Позиционный индекс не соответствует " << path << ", фразовые запросы отключены.\n";
+        return;
     }
 
-    std::vector<int> unique;
-    for (size_t k = 0; k < result.size(); ++k) {
-        if (k == 0 || result[k] != result[k - 1]) {
-            unique.push_back(result[k]);
-        }
+    uint64_t data_start = header + (count + 1) * sizeof(uint64_t);
+    if (file->size() < data_start) return;
+    std::vector<uint64_t> offsets(count + 1);
+    std::memcpy(offsets.data(), file->data() + header, offsets.size() * sizeof(uint64_t));
+    if (file->size() - data_start != offsets.back()) {
+        std::cerr << "Позиционный индекс повреждён " << path << ", фразовые запросы отключены.\n";
+        return;
     }
-    return unique;
+    positions.file = file;
+    positions.offsets = std::move(offsets);
+    positions.data_start = data_start;
 }
 
-std::vector<int> difference_lists(const std::vector<int>& a, const std::vector<int>& b) {
-    std::vector<int> result;
-    size_t i = 0, j = 0;
-    while (i < a.size()) {
-        if (j < b.size() && b[j] < a[i]) {
-            ++j;
-        } else if (j < b.size() && b[j] == a[i]) {
-            ++i; ++j;
-        } else {
-            result.push_back(a[i++]);
-        }
+// сегмент индекса; id - номер загрузки, уникальный за время работы процесса (ключ кэша posting листов)
+struct Segment {
+    uint64_t id = 0;
+    std::string name;
+    TermIndex index;
+    TrigramIndex trigrams;  // для шаблонов с * (wildcard.h)
+    CompletionIndex completion;  // подсказки по префиксу (suggest.h), пусто без файла
+    PositionIndex positions;
+    std::vector<uint8_t> deleted;
+    std::vector<int> db_ids;  // id в базе по внутреннему doc_id (indexer.exe --reorder), пусто - совпадают
+    DocAttributes attributes;  // источник и дата по внутреннему doc_id (attributes.h), пусто без файла
+};
+
+// раскодированные листы частых терминов; бюджет задаётся --postings-cache-mb
+PostingCache posting_cache;
+
+// короткие листы раскодируются быстрее, чем ищутся в кэше
+const uint32_t POSTING_CACHE_MIN_DOCS = 128;
+
+PostingList term_postings(const Segment& seg, size_t term_idx) {
+    StageTimer timer(query_stats, STAGE_POSTINGS);
+    const IndexEntry& entry = seg.index.postings[term_idx];
+    query_stats.add_postings(entry.doc_count);
+    bool cacheable = entry.doc_count >= POSTING_CACHE_MIN_DOCS && posting_cache.enabled();
+    uint64_t key = seg.id << 32 | term_idx;
+    PostingList list = cacheable ? posting_cache.get(key) : nullptr;
+    if (!list) {
+        query_stats.add_bytes(entry.packed.size());
+        list = std::make_shared<const std::vector<int>>(unpack_postings(entry));
+        if (cacheable) posting_cache.put(key, list);
     }
-    return result;
+    return list;
 }
 
-// загрузка индекса
+PostingList get_postings(const Segment& seg, const std::string& term) {
+    static const PostingList empty = std::make_shared<const std::vector<int>>();
+    long long idx = find_term(seg.index, term);
+    if (idx < 0) return empty;
+    return term_postings(seg, static_cast<size_t>(idx));
+}
 
-struct IndexEntry {
-    std::string term;
-    std::vector<int> postings;
-};
+// сколько терминов может дать один шаблон с * или нечёткий термин; --max-expansion, 0 - без ограничения
+size_t max_expansion = 1000;
 
-void load_index(const std::string& path, std::vector<IndexEntry>& index) {
-    std::ifstream in(path);
-    if (!in.is_open()) {
-        std::cerr << "Файл индекса не найден: " << path << "\n";
-        exit(1);
+// объединение листов терминов раскрытия; если терминов больше max_expansion, берутся самые частые
+std::vector<int> expanded_postings(const Segment& seg, std::vector<uint32_t> ids) {
+    if (max_expansion > 0 && ids.size() > max_expansion) {
+        const std::vector<IndexEntry>& postings = seg.index.postings;
+        std::nth_element(ids.begin(), ids.begin() + max_expansion, ids.end(), [&postings](uint32_t a, uint32_t b) {
+            return postings[a].doc_count > postings[b].doc_count;
+        });
+        ids.resize(max_expansion);
     }
-    std::string line;
-    while (std::getline(in, line)) {
-        if (line.empty()) continue;
-        size_t pos = line.find(':');
-        if (pos == std::string::npos) continue;
-        std::string term = line.substr(0, pos);
-        std::string rest = line.substr(pos + 1);
+    std::vector<PostingList> lists;
+    std::vector<const std::vector<int>*> parts;
+    for (uint32_t idx : ids) {
+        lists.push_back(term_postings(seg, idx));
+        parts.push_back(lists.back().get());
+    }
+    StageTimer timer(query_stats, STAGE_SET_OPS);
+    return union_many(parts);
+}
 
-        std::vector<int> docs;
-        std::stringstream ss(rest);
-        std::string id_str;
-        while (std::getline(ss, id_str, ',')) {
-            if (!id_str.empty()) {
-                docs.push_back(std::stoi(id_str));
-            }
-        }
-        index.push_back({term, std::move(docs)});
+std::vector<int> wildcard_postings(const Segment& seg, const std::string& pattern) {
+    std::vector<uint32_t> ids;
+    {
+        StageTimer timer(query_stats, STAGE_LOOKUP);
+        ids = expand_wildcard(seg.index.terms, seg.trigrams, pattern);
     }
+    return expanded_postings(seg, std::move(ids));
 }
 
-// бинарный поиск термина в отсортированном индексе
+std::vector<int> fuzzy_postings(const Segment& seg, const std::string& word, int distance) {
+    std::vector<uint32_t> ids;
+    {
+        StageTimer timer(query_stats, STAGE_LOOKUP);
+        ids = expand_fuzzy(seg.index.terms, word, distance);
+    }
+    return expanded_postings(seg, std::move(ids));
+}
 
-std::vector<int> get_postings(const std::vector<IndexEntry>& index, const std::string& term) {
-    size_t left = 0, right = index.size();
-    while (left < right) {
-        size_t mid = (left + right) / 2;
-        const std::string& mid_term = index[mid].term;
-        if (mid_term == term) {
-            return index[mid].postings;
-        } else if (mid_term < term) {
-            left = mid + 1;
-        } else {
-            right = mid;
+// позиции термина для документов из docs (docs отсортирован и входит в posting лист термина)
+std::vector<std::vector<int>> read_term_positions(const Segment& seg, size_t term_idx, const std::vector<int>& docs) {
+    PostingList list = term_postings(seg, term_idx);
+    StageTimer timer(query_stats, STAGE_POSTINGS);
+    const PositionIndex& positions = seg.positions;
+    std::vector<std::vector<int>> result(docs.size());
+    uint64_t begin = positions.offsets[term_idx];
+    uint64_t end = positions.offsets[term_idx + 1];
+
+    std::string block(positions.file->data() + positions.data_start + begin, end - begin);
+
+    query_stats.add_bytes(block.size());
+    const std::vector<int>& postings = *list;
+    size_t pos = 0, d = 0;
+    for (size_t k = 0; k < postings.size() && d < docs.size(); ++k) {
+        unsigned int len = 0;
+        if (!read_varint(block, pos, len) || pos + len > block.size()) break;
+        if (postings[k] != docs[d]) {
+            pos += len;
+            continue;
         }
+        size_t stop = pos + len;
+        int prev = 0;
+        while (pos < stop) {
+            unsigned int delta = 0;
+            if (!read_varint(block, pos, delta)) break;
+            prev += static_cast<int>(delta);
+            result[d].push_back(prev);
+        }
+        pos = stop;
+        ++d;
     }
-    return {};
+    return result;
 }
 
 std::string read_env_password() {
@@ -212,17 +320,7 @@ struct DocInfo {
     std::string title;
 };
 
-std::vector<DocInfo> fetch_metadata(const std::vector<int>& doc_ids, const DBConfig& cfg) {
-    if (doc_ids.empty()) return {};
-
-    std::ostringstream id_list;
-    for (size_t i = 0; i < doc_ids.size(); ++i) {
-        if (i > 0) id_list << ",";
-        id_list << doc_ids[i];
-    }
-
-    std::string query = "SELECT id, normalized_url, title FROM public.documents WHERE id IN (" + id_list.str() + ")";
-
+std::string connection_string(const DBConfig& cfg) {
     std::ostringstream conn_str;
     conn_str << "host=" << cfg.host
              << " port=" << cfg.port
@@ -230,31 +328,240 @@ std::vector<DocInfo> fetch_metadata(const std::vector<int>& doc_ids, const DBCon
              << " user=" << cfg.user
              << " password=" << cfg.password
              << " client_encoding=UTF8";
+    return conn_str.str();
+}
+
+// пул постоянных соединений, в каждом заранее подготовлен запрос метаданных
+
+const char* METADATA_STATEMENT = "doc_metadata";
+const char* METADATA_SQL = "SELECT id, normalized_url, title FROM public.documents WHERE id = ANY($1::bigint[])";
+
+class DBPool {
+public:
+    DBPool(const DBConfig& cfg, size_t size) : conninfo_(connection_string(cfg)), size_(size) {
+        for (size_t i = 0; i < size; ++i) {
+            PGconn* conn = open();
+            if (!conn) break;
+            free_.push_back(conn);
+            created_++;
+        }
+    }
+
+    ~DBPool() {
+        for (PGconn* conn : free_) PQfinish(conn);
+    }
+
+    // nullptr, если подключиться не удалось
+    PGconn* acquire() {
+        std::unique_lock<std::mutex> guard(lock_);
+        wake_.wait(guard, [this] { return !free_.empty() || created_ < size_; });
+        if (!free_.empty()) {
+            PGconn* conn = free_.back();
+            free_.pop_back();
+            return conn;
+        }
+        created_++;
+        guard.unlock();
+        PGconn* conn = open();
+        if (!conn) {
+            guard.lock();
+            created_--;
+            wake_.notify_one();
+        }
+        return conn;
+    }
+
+    // оборванное соединение закрывается, вместо него при следующем acquire откроется новое
+    void release(PGconn* conn) {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (PQstatus(conn) == CONNECTION_OK) {
+            free_.push_back(conn);
+        } else {
+            PQfinish(conn);
+            created_--;
+        }
+        wake_.notify_one();
+    }
+
+private:
+    PGconn* open() {
+        PGconn* conn = PQconnectdb(conninfo_.c_str());
+        if (PQstatus(conn) != CONNECTION_OK) {
+            std::cerr << "Ошибка подключения к бд: " << PQerrorMessage(conn) << "\n";
+            PQfinish(conn);
+            return nullptr;
+        }
+        PGresult* res = PQprepare(conn, METADATA_STATEMENT, METADATA_SQL, 1, nullptr);
+        bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+        if (!ok) std::cerr << "Ошибка SQL: " << PQerrorMessage(conn) << "\n";
+        PQclear(res);
+        if (!ok) {
+            PQfinish(conn);
+            return nullptr;
+        }
+        return conn;
+    }
+
+    std::string conninfo_;
+    size_t size_;
+    size_t created_ = 0;
+    std::vector<PGconn*> free_;
+    std::mutex lock_;
+    std::condition_variable wake_;
+};
+
+// bigint в бинарном формате результата - 8 байт big-endian
+long long read_be_int64(const char* p) {
+    unsigned long long v = 0;
+    for (int i = 0; i < 8; ++i) {
+        v = (v << 8) | static_cast<unsigned char>(p[i]);
+    }
+    return static_cast<long long>(v);
+}
 
-    PGconn* conn = PQconnectdb(conn_str.str().c_str());
-    if (PQstatus(conn) != CONNECTION_OK) {
-        std::cerr << "Ошибка подключения к бд: " << PQerrorMessage(conn) << "\n";
-        PQfinish(conn);
-        return {};
+std::string id_array_literal(const std::vector<int>& doc_ids) {
+    std::string id_array = "{";
+    for (size_t i = 0; i < doc_ids.size(); ++i) {
+        if (i > 0) id_array += ",";
+        id_array += std::to_string(doc_ids[i]);
+    }
+    id_array += "}";
+    return id_array;
+}
+
+// строки бинарного результата METADATA_STATEMENT в порядке doc_ids
+std::vector<DocInfo> parse_metadata(PGresult* res, const std::vector<int>& doc_ids) {
+    std::vector<DocInfo> found;
+    int rows = PQntuples(res);
+    for (int i = 0; i < rows; ++i) {
+        if (PQgetlength(res, i, 0) != 8) continue;
+        int id = static_cast<int>(read_be_int64(PQgetvalue(res, i, 0)));
+        std::string url(PQgetvalue(res, i, 1), PQgetlength(res, i, 1));
+        std::string title;
+        if (!PQgetisnull(res, i, 2)) title.assign(PQgetvalue(res, i, 2), PQgetlength(res, i, 2));
+        if (title.empty()) title = "(без заголовка)";
+        found.push_back({id, url, title});
     }
 
-    PGresult* res = PQexec(conn, query.c_str());
     std::vector<DocInfo> result;
-    if (PQresultStatus(res) == PGRES_TUPLES_OK) {
-        int rows = PQntuples(res);
-        for (int i = 0; i < rows; ++i) {
-            int id = std::stoi(PQgetvalue(res, i, 0));
-            std::string url = PQgetvalue(res, i, 1);
-            std::string title = PQgetvalue(res, i, 2);
-            if (title.empty()) title = "(без заголовка)";
-            result.push_back({id, url, title});
+    for (int id : doc_ids) {
+        for (const auto& info : found) {
+            if (info.id == id) {
+                result.push_back(info);
+                break;
+            }
         }
+    }
+    return result;
+}
+
+// метаданные только для переданной страницы doc_id, в том же порядке
+std::vector<DocInfo> fetch_metadata(const std::vector<int>& doc_ids, DBPool& pool) {
+    if (doc_ids.empty()) return {};
+    StageTimer timer(query_stats, STAGE_METADATA);
+
+    std::string id_array = id_array_literal(doc_ids);
+    PGconn* conn = pool.acquire();
+    if (!conn) return {};
+
+    const char* values[1] = {id_array.c_str()};
+    PGresult* res = PQexecPrepared(conn, METADATA_STATEMENT, 1, values, nullptr, nullptr, 1);
+    std::vector<DocInfo> result;
+    if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+        result = parse_metadata(res, doc_ids);
     } else {
         std::cerr << "Ошибка SQL: " << PQerrorMessage(conn) << "\n";
     }
-
     PQclear(res);
-    PQfinish(conn);
+    pool.release(conn);
+    return result;
+}
+
+// асинхронные запросы метаданных в режиме конвейера libpq: страницы отправляются,
+// как только известны их doc_id, база отвечает, пока запрос ещё вычисляется, результаты забирает wait_all
+class MetadataPipeline {
+public:
+    explicit MetadataPipeline(DBPool& pool) : pool_(pool), conn_(pool.acquire()) {
+        if (conn_ && PQenterPipelineMode(conn_) != 1) {
+            std::cerr << "Ошибка конвейера: " << PQerrorMessage(conn_) << "\n";
+            pool_.release(conn_);
+            conn_ = nullptr;
+        }
+    }
+
+    ~MetadataPipeline() {
+        if (!conn_) return;
+        wait_all();
+        PQexitPipelineMode(conn_);
+        pool_.release(conn_);
+    }
+
+    bool ok() const { return conn_ != nullptr; }
+    size_t requested() const { return requested_.size(); }
+
+    // номер страницы в порядке отправки
+    size_t request(const std::vector<int>& doc_ids) {
+        requested_.push_back(doc_ids);
+        received_.push_back({});
+        if (!conn_) return requested_.size() - 1;
+        std::string id_array = id_array_literal(doc_ids);
+        const char* values[1] = {id_array.c_str()};
+        if (PQsendQueryPrepared(conn_, METADATA_STATEMENT, 1, values, nullptr, nullptr, 1) != 1 ||
+            PQpipelineSync(conn_) != 1) {
+            std::cerr << "Ошибка SQL: " << PQerrorMessage(conn_) << "\n";
+            return requested_.size() - 1;
+        }
+        pending_.push_back(requested_.size() - 1);
+        return requested_.size() - 1;
+    }
+
+    void wait_all() {
+        if (conn_) drain();
+    }
+
+    const std::vector<DocInfo>& page(size_t page) const { return received_[page]; }
+
+private:
+    // результат каждой страницы: TUPLES_OK, NULL, затем PIPELINE_SYNC
+    void drain() {
+        while (!pending_.empty()) {
+            PGresult* res = PQgetResult(conn_);
+            if (!res) {
+                if (PQstatus(conn_) != CONNECTION_BAD) continue;
+                std::cerr << "Ошибка подключения к бд: " << PQerrorMessage(conn_) << "\n";
+                pending_.clear();
+                return;
+            }
+            ExecStatusType status = PQresultStatus(res);
+            size_t page = pending_.front();
+            if (status == PGRES_TUPLES_OK) {
+                received_[page] = parse_metadata(res, requested_[page]);
+            } else if (status == PGRES_PIPELINE_SYNC) {
+                pending_.pop_front();
+            } else if (status != PGRES_PIPELINE_ABORTED) {
+                std::cerr << "Ошибка SQL: " << PQresultErrorMessage(res) << "\n";
+            }
+            PQclear(res);
+        }
+    }
+
+    DBPool& pool_;
+    PGconn* conn_;
+    std::vector<std::vector<int>> requested_;
+    std::vector<std::vector<DocInfo>> received_;
+    std::deque<size_t> pending_;
+};
+
+// метаданные страницы из локального docstore.bin, без обращения к базе
+std::vector<DocInfo> lookup_metadata(const std::vector<int>& doc_ids, const DocStore& store) {
+    StageTimer timer(query_stats, STAGE_METADATA);
+    std::vector<DocInfo> result;
+    for (int id : doc_ids) {
+        DocInfo info{id, "", ""};
+        if (!store.lookup(id, info.normalized_url, info.title)) continue;
+        if (info.title.empty()) info.title = "(без заголовка)";
+        result.push_back(std::move(info));
+    }
     return result;
 }
 
@@ -269,97 +576,1875 @@ std::string to_lower(const std::string& s) {
     return r;
 }
 
-std::vector<int> execute_query(const std::string& raw_query, const std::vector<IndexEntry>& index) {
-    std::istringstream iss(raw_query);
+// разбор запроса на лексемы: слова, фразы в кавычках, скобки
+
+std::vector<std::string> lex_query(const std::string& raw_query) {
     std::vector<std::string> tokens;
-    std::string tok;
-    while (iss >> tok) {
-        tokens.push_back(to_lower(tok));
+    std::string current;
+    auto flush = [&]() {
+        if (!current.empty()) tokens.push_back(to_lower(current));
+        current.clear();
+    };
+
+    for (size_t i = 0; i < raw_query.size(); ++i) {
+        char c = raw_query[i];
+        if (c == '"') {
+            flush();
+            size_t close = raw_query.find('"', i + 1);
+            if (close == std::string::npos) close = raw_query.size();
+            tokens.push_back("\"" + to_lower(raw_query.substr(i + 1, close - i - 1)));
+            i = close;
+        } else if (c == '(' || c == ')') {
+            flush();
+            tokens.push_back(std::string(1, c));
+        } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            flush();
+        } else {
+            current += c;
+        }
     }
+    flush();
+    return tokens;
+}
+
+// дерево запроса
+
+struct QueryNode {
+    enum Type { TERM, PHRASE, NEAR, AND, OR, AND_NOT, WILDCARD, FUZZY, SOURCE, DATE };
+    Type type;
+    std::vector<std::string> terms;   // TERM: один термин, PHRASE: термины по порядку, WILDCARD: шаблон, FUZZY: слово,
+                                      // SOURCE: источник, DATE: диапазон дат (parse_date_range)
+    int distance = 0;                 // NEAR/k, FUZZY: число правок
+    std::vector<QueryNode> children;
+};
 
-    if (tokens.empty()) return {};
+// or_expr   := and_expr ("or" and_expr)*
+// and_expr  := near_expr ("and" ["not"] near_expr)*
+// near_expr := primary ("near/k" primary)*
+// primary   := термин | шаблон с * | термин~k | source:сайт | date:диапазон | "фраза" | "(" or_expr ")"
+struct QueryParser {
+    const std::vector<std::string>& tokens;
+    size_t pos = 0;
+    bool ok = true;
 
-    if (tokens.size() == 1) {
-        return get_postings(index, tokens[0]);
+    explicit QueryParser(const std::vector<std::string>& t) : tokens(t) {}
+
+    bool at_end() const { return pos >= tokens.size(); }
+    const std::string& peek() const { return tokens[pos]; }
+
+    static bool is_keyword(const std::string& t) {
+        return t == "and" || t == "or" || t == "not" || t == "(" || t == ")" || t.rfind("near/", 0) == 0;
     }
-    if (tokens.size() == 3) {
-        if (tokens[1] == "and") {
-            auto a = get_postings(index, tokens[0]);
-            auto b = get_postings(index, tokens[2]);
-            return intersect_lists(a, b);
+
+    QueryNode parse_or() {
+        QueryNode left = parse_and();
+        while (ok && !at_end() && peek() == "or") {
+            ++pos;
+            QueryNode node{QueryNode::OR, {}, 0, {}};
+            node.children.push_back(std::move(left));
+            node.children.push_back(parse_and());
+            left = std::move(node);
         }
-        if (tokens[1] == "or") {
-            auto a = get_postings(index, tokens[0]);
-            auto b = get_postings(index, tokens[2]);
-            return union_lists(a, b);
+        return left;
+    }
+
+    QueryNode parse_and() {
+        QueryNode left = parse_near();
+        while (ok && !at_end() && peek() == "and") {
+            ++pos;
+            QueryNode::Type type = QueryNode::AND;
+            if (!at_end() && peek() == "not") {
+                type = QueryNode::AND_NOT;
+                ++pos;
+            }
+            QueryNode node{type, {}, 0, {}};
+            node.children.push_back(std::move(left));
+            node.children.push_back(parse_near());
+            left = std::move(node);
         }
+        return left;
     }
-    if (tokens.size() == 4 && tokens[1] == "and" && tokens[2] == "not") {
-        auto a = get_postings(index, tokens[0]);
-        auto b = get_postings(index, tokens[3]);
-        return difference_lists(a, b);
+
+    QueryNode parse_near() {
+        QueryNode left = parse_primary();
+        while (ok && !at_end() && peek().rfind("near/", 0) == 0) {
+            int distance = 0;
+            try {
+                distance = std::stoi(peek().substr(5));
+            } catch (const std::exception&) {
+                ok = false;
+                return left;
+            }
+            ++pos;
+            QueryNode node{QueryNode::NEAR, {}, distance, {}};
+            node.children.push_back(std::move(left));
+            node.children.push_back(parse_primary());
+            if (distance < 1 || !is_positional(node.children[0]) || !is_positional(node.children[1])) {
+                ok = false;
+            }
+            left = std::move(node);
+        }
+        return left;
     }
 
-    std::cerr << "Неподдерживаемый запрос.\n";
-    return {};
-}
+    QueryNode parse_primary() {
+        if (at_end()) {
+            ok = false;
+            return {};
+        }
+        std::string tok = tokens[pos++];
+        if (tok == "(") {
+            QueryNode inner = parse_or();
+            if (at_end() || peek() != ")") {
+                ok = false;
+            } else {
+                ++pos;
+            }
+            return inner;
+        }
+        if (tok[0] == '"') {
+            QueryNode node{QueryNode::PHRASE, {}, 0, {}};
+            std::istringstream iss(tok.substr(1));
+            std::string word;
+            while (iss >> word) {
+                if (word.find('*') != std::string::npos) ok = false;  // шаблоны во фразах не поддерживаются
+                node.terms.push_back(word);
+            }
+            if (node.terms.empty()) ok = false;
+            if (node.terms.size() == 1) node.type = QueryNode::TERM;
+            return node;
+        }
+        if (is_keyword(tok)) {
+            ok = false;
+            return {};
+        }
+        if (tok.rfind("source:", 0) == 0) {
+            if (tok.size() == 7) ok = false;
+            return {QueryNode::SOURCE, {tok.substr(7)}, 0, {}};
+        }
+        if (tok.rfind("date:", 0) == 0) {
+            int from = 0, to = 0;
+            if (!parse_date_range(tok.substr(5), from, to)) ok = false;
+            return {QueryNode::DATE, {tok.substr(5)}, 0, {}};
+        }
+        size_t tilde = tok.rfind('~');
+        if (tilde != std::string::npos && tok.find('*') == std::string::npos) {
+            // term~1, term~2: термины на расстоянии Левенштейна не больше k
+            std::string suffix = tok.substr(tilde + 1);
+            int distance = suffix.size() == 1 && suffix[0] >= '1' && suffix[0] <= '0' + FUZZY_MAX_DISTANCE
+                               ? suffix[0] - '0' : 0;
+            if (tilde == 0 || distance == 0) ok = false;
+            return {QueryNode::FUZZY, {tok.substr(0, tilde)}, distance, {}};
+        }
+        if (tok.find('*') != std::string::npos) {
+            // шаблон из одних * раскрылся бы во весь словарь
+            if (tok.find_first_not_of('*') == std::string::npos) ok = false;
+            return {QueryNode::WILDCARD, {tok}, 0, {}};
+        }
+        return {QueryNode::TERM, {tok}, 0, {}};
+    }
 
+    static bool is_positional(const QueryNode& node) {
+        return node.type == QueryNode::TERM || node.type == QueryNode::PHRASE;
+    }
+};
 
-int main(int argc, char* argv[]) {
-    setup_utf8_console();
+// документы с позициями начала совпадения (для фраз и NEAR)
+struct PositionalMatches {
+    std::vector<int> docs;
+    std::vector<std::vector<int>> positions;
+};
 
-    bool ids_only_mode = false;
-    if (argc == 2 && std::string(argv[1]) == "--ids-only") {
-        ids_only_mode = true;
-    } else if (argc > 1) {
-        return 1;
+// фраза: пересечение posting листов, затем пересечение сдвинутых позиционных списков
+PositionalMatches match_phrase(const std::vector<std::string>& terms, const Segment& seg) {
+    PositionalMatches result;
+    std::vector<size_t> term_ids;
+    for (const auto& term : terms) {
+        long long idx = find_term(seg.index, term);
+        if (idx < 0) return result;
+        term_ids.push_back(static_cast<size_t>(idx));
     }
 
-    std::cout << "Загрузка индекса.\n";
-    std::vector<IndexEntry> index;
-    load_index("boolean_index.txt", index);
-    DBConfig cfg = load_db_config();
+    std::vector<int> docs = *term_postings(seg, term_ids[0]);
+    for (size_t i = 1; i < term_ids.size() && !docs.empty(); ++i) {
+        docs = intersect_lists(docs, *term_postings(seg, term_ids[i]));
+    }
+    if (docs.empty()) return result;
 
-    if (ids_only_mode) {
-        std::cout << "Режим: только ID. Введите запрос:\n";
-    } else {
-        std::cout << "\nВведите запрос:\n";
+    std::vector<std::vector<int>> starts = read_term_positions(seg, term_ids[0], docs);
+    for (size_t i = 1; i < term_ids.size(); ++i) {
+        std::vector<std::vector<int>> next = read_term_positions(seg, term_ids[i], docs);
+        for (size_t d = 0; d < docs.size(); ++d) {
+            std::vector<int> kept;
+            const std::vector<int>& a = starts[d];
+            const std::vector<int>& b = next[d];
+            size_t x = 0, y = 0;
+            int shift = static_cast<int>(i);
+            while (x < a.size() && y < b.size()) {
+                if (a[x] + shift == b[y]) {
+                    kept.push_back(a[x]);
+                    ++x; ++y;
+                } else if (a[x] + shift < b[y]) {
+                    ++x;
+                } else {
+                    ++y;
+                }
+            }
+            starts[d] = std::move(kept);
+        }
     }
 
-    std::string query;
-    while (std::getline(std::cin, query)) {
-        if (query == "exit") break;
-        if (query.empty()) continue;
+    for (size_t d = 0; d < docs.size(); ++d) {
+        if (!starts[d].empty()) {
+            result.docs.push_back(docs[d]);
+            result.positions.push_back(std::move(starts[d]));
+        }
+    }
+    return result;
+}
 
-        auto doc_ids = execute_query(query, index);
-        if (doc_ids.empty()) {
-            if (!ids_only_mode) {
-                std::cout << "Ничего не найдено.\n\n";
+// NEAR/k: есть пара позиций на расстоянии не больше k (в любом порядке)
+PositionalMatches match_near(const PositionalMatches& a, const PositionalMatches& b, int distance) {
+    PositionalMatches result;
+    size_t i = 0, j = 0;
+    while (i < a.docs.size() && j < b.docs.size()) {
+        if (a.docs[i] < b.docs[j]) {
+            ++i;
+        } else if (a.docs[i] > b.docs[j]) {
+            ++j;
+        } else {
+            std::vector<int> kept;
+            const std::vector<int>& pa = a.positions[i];
+            const std::vector<int>& pb = b.positions[j];
+            size_t y = 0;
+            for (size_t x = 0; x < pa.size(); ++x) {
+                while (y < pb.size() && pb[y] < pa[x] - distance) ++y;
+                if (y < pb.size() && pb[y] <= pa[x] + distance) kept.push_back(pa[x]);
             }
-            if (!ids_only_mode) {
-                std::cout << "\nВведите запрос:\n";
+            if (!kept.empty()) {
+                result.docs.push_back(a.docs[i]);
+                result.positions.push_back(std::move(kept));
             }
-            continue;
+            ++i; ++j;
         }
+    }
+    return result;
+}
 
-        if (ids_only_mode) {
-            std::cout << "Найдено: " << doc_ids.size() << " документов\n";
-            for (int id : doc_ids) {
-                std::cout << id << "\n";
+PositionalMatches evaluate_positional(const QueryNode& node, const Segment& seg) {
+    if (node.type == QueryNode::NEAR) {
+        return match_near(evaluate_positional(node.children[0], seg),
+                          evaluate_positional(node.children[1], seg), node.distance);
+    }
+    return match_phrase(node.terms, seg);
+}
+
+bool needs_positions(const QueryNode& node) {
+    if (node.type == QueryNode::PHRASE || node.type == QueryNode::NEAR) return true;
+    for (const auto& child : node.children) {
+        if (needs_positions(child)) return true;
+    }
+    return false;
+}
+
+// фильтры source: и date: проверяются по столбцам атрибутов сегмента документ за документом,
+// внутри обхода posting листов другого операнда AND, а не отдельным списком doc_id
+
+// дерево из одних фильтров (и их AND, OR, AND NOT)
+bool is_filter(const QueryNode& node) {
+    if (node.type == QueryNode::SOURCE || node.type == QueryNode::DATE) return true;
+    if (node.type != QueryNode::AND && node.type != QueryNode::OR && node.type != QueryNode::AND_NOT) return false;
+    return is_filter(node.children[0]) && is_filter(node.children[1]);
+}
+
+bool has_filter(const QueryNode& node) {
+    if (node.type == QueryNode::SOURCE || node.type == QueryNode::DATE) return true;
+    for (const auto& child : node.children) {
+        if (has_filter(child)) return true;
+    }
+    return false;
+}
+
+// фильтр, подготовленный для сегмента: имя источника заменено номером, даты - днями
+struct AttributeFilter {
+    QueryNode::Type type = QueryNode::SOURCE;
+    int source = -1;        // SOURCE: -1 - источника нет в сегменте
+    int from = 0, to = 0;   // DATE: дни с 1970-01-01 включительно
+    std::vector<AttributeFilter> children;
+
+    bool matches(const DocAttributes& attributes, int doc) const {
+        switch (type) {
+            case QueryNode::SOURCE:
+                return source >= 0 && attributes.in_source(doc, source);
+            case QueryNode::DATE: {
+                int day = attributes.day(doc);
+                return day >= from && day <= to;
             }
-            std::cout << "Найдено: " << doc_ids.size() << " документов\n";
-            std::cout << "\nВведите запрос:\n";
-        } else {
-            auto results = fetch_metadata(doc_ids, cfg);
-            std::cout << "Найдено: " << results.size() << " документов\n";
-            for (const auto& r : results) {
-                std::cout << "[id: " << r.id << "] " << r.title << " — " << r.normalized_url << "\n";
+            case QueryNode::AND:
+                return children[0].matches(attributes, doc) && children[1].matches(attributes, doc);
+            case QueryNode::OR:
+                return children[0].matches(attributes, doc) || children[1].matches(attributes, doc);
+            case QueryNode::AND_NOT:
+                return children[0].matches(attributes, doc) && !children[1].matches(attributes, doc);
+            default:
+                return false;
+        }
+    }
+};
+
+AttributeFilter compile_filter(const QueryNode& node, const Segment& seg) {
+    AttributeFilter filter;
+    filter.type = node.type;
+    if (node.type == QueryNode::SOURCE) {
+        filter.source = seg.attributes.source_id(node.terms[0]);
+    } else if (node.type == QueryNode::DATE) {
+        parse_date_range(node.terms[0], filter.from, filter.to);
+    }
+    for (const auto& child : node.children) filter.children.push_back(compile_filter(child, seg));
+    return filter;
+}
+
+// документы, проходящие фильтр без других условий: источник - по битовой карте, остальное - просмотром столбцов
+std::vector<int> filter_docs(const QueryNode& node, const Segment& seg) {
+    StageTimer timer(query_stats, STAGE_SET_OPS);
+    AttributeFilter filter = compile_filter(node, seg);
+    if (node.type == QueryNode::SOURCE) {
+        return filter.source >= 0 ? seg.attributes.source_docs(filter.source) : std::vector<int>();
+    }
+    std::vector<int> docs;
+    for (size_t row = 0; row < seg.attributes.doc_count(); ++row) {
+        int doc = seg.attributes.doc_at(row);
+        if (filter.matches(seg.attributes, doc)) docs.push_back(doc);
+    }
+    return docs;
+}
+
+// keep = true - оставить документы docs, проходящие фильтр, false - не проходящие
+std::vector<int> apply_filter(const std::vector<int>& docs, const QueryNode& node, const Segment& seg, bool keep) {
+    StageTimer timer(query_stats, STAGE_SET_OPS);
+    AttributeFilter filter = compile_filter(node, seg);
+    std::vector<int> result;
+    for (int doc : docs) {
+        if (filter.matches(seg.attributes, doc) == keep) result.push_back(doc);
+    }
+    return result;
+}
+
+std::vector<int> evaluate(const QueryNode& node, const Segment& seg) {
+    if (is_filter(node)) return filter_docs(node, seg);
+    if (node.type == QueryNode::AND && is_filter(node.children[0])) {
+        return apply_filter(evaluate(node.children[1], seg), node.children[0], seg, true);
+    }
+    if ((node.type == QueryNode::AND || node.type == QueryNode::AND_NOT) && is_filter(node.children[1])) {
+        return apply_filter(evaluate(node.children[0], seg), node.children[1], seg, node.type == QueryNode::AND);
+    }
+    switch (node.type) {
+        case QueryNode::TERM:
+            return *get_postings(seg, node.terms[0]);
+        case QueryNode::WILDCARD:
+            return wildcard_postings(seg, node.terms[0]);
+        case QueryNode::FUZZY:
+            return fuzzy_postings(seg, node.terms[0], node.distance);
+        case QueryNode::PHRASE:
+        case QueryNode::NEAR:
+            return evaluate_positional(node, seg).docs;
+        case QueryNode::AND:
+        case QueryNode::OR:
+        case QueryNode::AND_NOT: {
+            std::vector<int> a = evaluate(node.children[0], seg);
+            std::vector<int> b = evaluate(node.children[1], seg);
+            StageTimer timer(query_stats, STAGE_SET_OPS);
+            if (node.type == QueryNode::AND) return intersect_lists(a, b);
+            if (node.type == QueryNode::OR) return union_lists(a, b);
+            return difference_lists(a, b);
+        }
+        case QueryNode::SOURCE:
+        case QueryNode::DATE:
+            break;
+    }
+    return {};
+}
+
+// индекс - один boolean_index.txt или набор сегментов из segments/segments.txt
+
+// версия индекса: поколение манифеста сегментов или время изменения boolean_index.txt
+// (и записываемых вместе с ним positions.bin, suggest.bin, doc_ids.txt, duplicates.txt и attributes.bin)
+std::string current_index_version() {
+    SegmentManifest manifest;
+    if (read_manifest(SEGMENTS_MANIFEST, manifest)) {
+        return "segments:" + std::to_string(manifest.generation);
+    }
+    std::error_code ec;
+    auto index_time = std::filesystem::last_write_time("boolean_index.txt", ec);
+    if (ec) return "";
+    auto positions_time = std::filesystem::last_write_time("positions.bin", ec);
+    std::string version = "file:" + std::to_string(index_time.time_since_epoch().count()) + ":" +
+                          (ec ? std::string("-") : std::to_string(positions_time.time_since_epoch().count()));
+    auto suggest_time = std::filesystem::last_write_time("suggest.bin", ec);
+    version += ":" + (ec ? std::string("-") : std::to_string(suggest_time.time_since_epoch().count()));
+    auto map_time = std::filesystem::last_write_time(DOC_MAP_FILE, ec);
+    version += ":" + (ec ? std::string("-") : std::to_string(map_time.time_since_epoch().count()));
+    auto dup_time = std::filesystem::last_write_time(DUPLICATES_FILE, ec);
+    version += ":" + (ec ? std::string("-") : std::to_string(dup_time.time_since_epoch().count()));
+    auto attributes_time = std::filesystem::last_write_time("attributes.bin", ec);
+    return version + ":" + (ec ? std::string("-") : std::to_string(attributes_time.time_since_epoch().count()));
+}
+
+// неизменяемый снимок индекса; запрос держит shared_ptr на снимок до конца выполнения
+struct IndexSnapshot {
+    std::string version;
+    std::vector<Segment> segments;
+    DuplicateTable duplicates;  // id в базе, общая для всех сегментов; пусто без duplicates.txt
+};
+
+std::atomic<uint64_t> next_segment_id{1};
+
+// подсказки сегмента; без файла (индекс старой версии) или от другого словаря подсказок по сегменту нет
+void load_completion(const std::string& path, Segment& seg) {
+    if (!seg.completion.load(path)) return;
+    if (seg.completion.term_count() != seg.index.size()) {
+        std::cerr << path << " построен для другого словаря, подсказки по нему отключены\n";
+        seg.completion = CompletionIndex();
+    }
+}
+
+std::shared_ptr<const IndexSnapshot> load_snapshot() {
+    auto snapshot = std::make_shared<IndexSnapshot>();
+    snapshot->version = current_index_version();
+    snapshot->duplicates.load(DUPLICATES_FILE);
+
+    SegmentManifest manifest;
+    if (read_manifest(SEGMENTS_MANIFEST, manifest)) {
+        for (const auto& info : manifest.segments) {
+            Segment seg;
+            seg.id = next_segment_id++;
+            seg.name = info.name;
+            if (!load_index(SEGMENTS_DIR + "/" + info.name + ".idx", seg.index)) return nullptr;
+            seg.trigrams.build(seg.index.terms);
+            load_positions(SEGMENTS_DIR + "/" + info.name + ".pos", seg.index.size(), seg.positions);
+            load_completion(SEGMENTS_DIR + "/" + info.name + ".sug", seg);
+            seg.attributes.load(SEGMENTS_DIR + "/" + info.name + ".attr");
+            if (!info.tombstones.empty()) seg.deleted = read_tombstones(SEGMENTS_DIR + "/" + info.tombstones);
+            snapshot->segments.push_back(std::move(seg));
+        }
+        snapshot->version = "segments:" + std::to_string(manifest.generation);
+        return snapshot;
+    }
+
+    Segment seg;
+    seg.id = next_segment_id++;
+    seg.name = "boolean_index.txt";
+    if (!load_index("boolean_index.txt", seg.index)) return nullptr;
+    seg.trigrams.build(seg.index.terms);
+    load_positions("positions.bin", seg.index.size(), seg.positions);
+    load_completion("suggest.bin", seg);
+    seg.db_ids = read_doc_map(DOC_MAP_FILE);
+    seg.attributes.load("attributes.bin");
+    snapshot->segments.push_back(std::move(seg));
+    return snapshot;
+}
+
+// текущая версия индекса: читатели берут снимок атомарно, фоновый поток подменяет его целиком.
+// Старый снимок освобождается, когда его отпустит последний запрос.
+class IndexHolder {
+public:
+    explicit IndexHolder(std::shared_ptr<const IndexSnapshot> initial) : current_(std::move(initial)) {}
+
+    std::shared_ptr<const IndexSnapshot> get() const { return std::atomic_load(&current_); }
+    void set(std::shared_ptr<const IndexSnapshot> next) { std::atomic_store(&current_, std::move(next)); }
+
+private:
+    std::shared_ptr<const IndexSnapshot> current_;
+};
+
+// фоновая перезагрузка: версия должна не меняться два опроса подряд, чтобы не читать недописанный индекс
+class IndexWatcher {
+public:
+    IndexWatcher(IndexHolder& holder, std::chrono::milliseconds interval)
+        : holder_(holder), interval_(interval), thread_([this] { run(); }) {}
+
+    ~IndexWatcher() {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        thread_.join();
+    }
+
+private:
+    void run() {
+        std::string pending;
+        std::unique_lock<std::mutex> guard(lock_);
+        while (!wake_.wait_for(guard, interval_, [this] { return stop_; })) {
+            guard.unlock();
+            std::string version = current_index_version();
+            if (version.empty() || version == holder_.get()->version) {
+                pending.clear();
+            } else if (version != pending) {
+                pending = version;
+            } else {
+                auto next = load_snapshot();
+                if (next && next->version == version) {
+                    holder_.set(std::move(next));
+                    std::cerr << "Загружена новая версия индекса (" << version << ")\n";
+                }
+                pending.clear();
             }
-            std::cout << "Найдено: " << results.size() << " документов\n";
-            std::cout << "\n \n";
-            std::cout << "\nВведите запрос:\n";
+            guard.lock();
         }
     }
 
-    return 0;
-}
\ No newline at end of file
+    IndexHolder& holder_;
+    std::chrono::milliseconds interval_;
+    std::mutex lock_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+// прогрев по журналу запросов: листы частых терминов раскодируются в posting_cache,
+// страницы их блоков positions.bin читаются, чтобы попасть в файловый кэш ОС
+void prefetch_positions(const Segment& seg, size_t term_idx) {
+    const PositionIndex& positions = seg.positions;
+    uint64_t begin = positions.offsets[term_idx];
+    uint64_t end = positions.offsets[term_idx + 1];
+    const char* data = positions.file->data() + positions.data_start;
+    volatile char sink = 0;
+    for (uint64_t i = begin; i < end; i += 4096) sink = sink ^ data[i];
+}
+
+void warm_up(std::shared_ptr<const IndexSnapshot> snapshot, const std::vector<std::string>& terms) {
+    // прогрев - не запросы, в --stats он не попадает
+    StatsPause pause;
+    auto start = std::chrono::steady_clock::now();
+    size_t found = 0;
+    for (const auto& term : terms) {
+        for (const auto& seg : snapshot->segments) {
+            long long idx = find_term(seg.index, term);
+            if (idx < 0) continue;
+            ++found;
+            term_postings(seg, static_cast<size_t>(idx));
+            if (seg.positions.available()) prefetch_positions(seg, static_cast<size_t>(idx));
+        }
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Прогрев: " << terms.size() << " терминов из журнала, " << found << " posting листов, "
+              << static_cast<long long>(ms) << " мс\n";
+}
+
+std::vector<int> remove_deleted(const std::vector<int>& docs, const std::vector<uint8_t>& deleted) {
+    if (deleted.empty()) return docs;
+    std::vector<int> result;
+    for (int id : docs) {
+        if (!is_tombstoned(deleted, id)) result.push_back(id);
+    }
+    return result;
+}
+
+// частые термины запросов для прогрева при следующем запуске (--warmup)
+QueryTermLog query_log;
+
+void collect_terms(const QueryNode& node, std::vector<std::string>& terms) {
+    if (node.type == QueryNode::WILDCARD || node.type == QueryNode::FUZZY || node.type == QueryNode::SOURCE ||
+        node.type == QueryNode::DATE) {
+        return;
+    }
+    terms.insert(terms.end(), node.terms.begin(), node.terms.end());
+    for (const auto& child : node.children) collect_terms(child, terms);
+}
+
+// разбор запроса и проверка, что для него хватает индекса; false - пустой запрос или ошибка.
+// error: если задан, сообщение об ошибке пишется туда, иначе в std::cerr
+bool parse_query(const std::string& raw_query, const std::vector<Segment>& segments, QueryNode& root,
+                 std::string* error = nullptr) {
+    auto report = [error](const std::string& message) {
+        if (error) {
+            *error = message;
+        } else {
+            std::cerr << message << "\n";
+        }
+    };
+
+    StageTimer timer(query_stats, STAGE_PARSE);
+    std::vector<std::string> tokens = lex_query(raw_query);
+    if (tokens.empty()) return false;
+    query_stats.add_query();
+
+    QueryParser parser(tokens);
+    root = parser.parse_or();
+    if (!parser.ok || !parser.at_end()) {
+        report("Неподдерживаемый запрос.");
+        return false;
+    }
+    bool positional = needs_positions(root);
+    bool filtered = has_filter(root);
+    for (const auto& seg : segments) {
+        if (positional && !seg.positions.available()) {
+            report("Позиционный индекс не загружен (indexer.exe --positions).");
+            return false;
+        }
+        if (filtered && seg.attributes.empty()) {
+            report("Атрибуты документов не загружены (doc_attributes.txt от exporter.exe, затем indexer.exe).");
+            return false;
+        }
+    }
+    if (query_log.enabled()) {
+        std::vector<std::string> terms;
+        collect_terms(root, terms);
+        query_log.record(terms);
+    }
+    return true;
+}
+
+// каноническая запись дерева для ключа кэша: вложенные AND/OR одного типа раскрываются,
+// операнды AND, OR и NEAR (он симметричен) сортируются, повторы в AND/OR убираются.
+// Слово в запросе может содержать любые символы ("x~1" в кавычках - обычный термин, а не x~1),
+// поэтому у каждого вида листа свой префикс: t: термин, w: шаблон, f: нечёткий термин,
+// source: и date: у фильтров (термин "source:x" в кавычках получает ключ t:source:x)
+void collect_operands(const QueryNode& node, QueryNode::Type type, std::vector<std::string>& out);
+
+std::string canonical_query(const QueryNode& node) {
+    switch (node.type) {
+        case QueryNode::TERM:
+            return "t:" + node.terms[0];
+        case QueryNode::WILDCARD:
+            return "w:" + node.terms[0];
+        case QueryNode::FUZZY:
+            return "f:" + node.terms[0] + "~" + std::to_string(node.distance);
+        case QueryNode::SOURCE:
+            return "source:" + node.terms[0];
+        case QueryNode::DATE:
+            return "date:" + node.terms[0];
+        case QueryNode::PHRASE: {
+            std::string out = "\"";
+            for (size_t i = 0; i < node.terms.size(); ++i) {
+                if (i > 0) out += ' ';
+                out += node.terms[i];
+            }
+            return out + "\"";
+        }
+        case QueryNode::NEAR: {
+            std::string a = canonical_query(node.children[0]), b = canonical_query(node.children[1]);
+            if (b < a) std::swap(a, b);
+            return "near/" + std::to_string(node.distance) + "(" + a + " " + b + ")";
+        }
+        case QueryNode::AND_NOT:
+            return "not(" + canonical_query(node.children[0]) + " " + canonical_query(node.children[1]) + ")";
+        case QueryNode::AND:
+        case QueryNode::OR: {
+            std::vector<std::string> operands;
+            collect_operands(node, node.type, operands);
+            std::sort(operands.begin(), operands.end());
+            operands.erase(std::unique(operands.begin(), operands.end()), operands.end());
+            if (operands.size() == 1) return operands[0];
+            std::string out = node.type == QueryNode::AND ? "and(" : "or(";
+            for (size_t i = 0; i < operands.size(); ++i) {
+                if (i > 0) out += ' ';
+                out += operands[i];
+            }
+            return out + ")";
+        }
+    }
+    return "";
+}
+
+void collect_operands(const QueryNode& node, QueryNode::Type type, std::vector<std::string>& out) {
+    if (node.type != type) {
+        out.push_back(canonical_query(node));
+        return;
+    }
+    for (const auto& child : node.children) collect_operands(child, type, out);
+}
+
+// внутренние doc_id перенумерованного индекса -> id в базе, по возрастанию, как у индекса без перенумерации
+std::vector<int> to_db_ids(const std::vector<int>& docs, const Segment& seg) {
+    if (seg.db_ids.empty()) return docs;
+    std::vector<int> result;
+    result.reserve(docs.size());
+    for (int id : docs) {
+        if (static_cast<size_t>(id) < seg.db_ids.size()) result.push_back(seg.db_ids[id]);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+// --collapse-duplicates: из кластера почти одинаковых документов (near_dup.h) в результате остаётся
+// первый по порядку doc_id, остальные пропускаются
+bool collapse_duplicates = false;
+
+std::vector<int> collapse_duplicate_docs(const std::vector<int>& docs, const DuplicateTable& duplicates) {
+    if (!collapse_duplicates || duplicates.empty()) return docs;
+    std::unordered_set<int> seen;
+    std::vector<int> result;
+    for (int id : docs) {
+        if (seen.insert(duplicates.representative(id)).second) result.push_back(id);
+    }
+    return result;
+}
+
+std::vector<int> evaluate_segments(const QueryNode& root, const IndexSnapshot& snapshot) {
+    // каждый живой документ есть ровно в одном сегменте, поэтому результаты сегментов объединяются
+    std::vector<int> result;
+    for (const auto& seg : snapshot.segments) {
+        std::vector<int> docs = evaluate(root, seg);
+        StageTimer timer(query_stats, STAGE_SET_OPS);
+        docs = to_db_ids(remove_deleted(docs, seg.deleted), seg);
+        result = result.empty() ? std::move(docs) : union_lists(result, docs);
+    }
+    StageTimer timer(query_stats, STAGE_SET_OPS);
+    return collapse_duplicate_docs(result, snapshot.duplicates);
+}
+
+// cache: если задан, результат берётся из кэша или кладётся туда после вычисления
+std::vector<int> execute_query(const std::string& raw_query, const IndexSnapshot& snapshot,
+                               std::string* error = nullptr, QueryCache* cache = nullptr) {
+    QueryNode root;
+    if (!parse_query(raw_query, snapshot.segments, root, error)) return {};
+    if (!cache || !cache->enabled()) return evaluate_segments(root, snapshot);
+
+    std::string key = canonical_query(root);
+    std::vector<int> result;
+    if (cache->get(key, snapshot.version, result)) return result;
+    result = evaluate_segments(root, snapshot);
+    cache->put(key, snapshot.version, result);
+    return result;
+}
+
+// потоковое вычисление запроса (документ за документом): первые doc_id результата известны
+// до того, как слиты posting листы целиком, - по ним можно заранее запросить метаданные
+
+const int END_OF_STREAM = std::numeric_limits<int>::max();
+
+struct DocStream {
+    virtual ~DocStream() = default;
+    virtual int doc() const = 0;
+    virtual void next() = 0;
+    // первый doc_id >= target
+    virtual void advance(int target) {
+        while (doc() < target) next();
+    }
+};
+
+// posting лист термина (общий с кэшем) или вычисленный список (фразы, NEAR)
+class ListStream : public DocStream {
+public:
+    explicit ListStream(PostingList list) : list_(std::move(list)) {}
+    explicit ListStream(std::vector<int> owned) : list_(std::make_shared<const std::vector<int>>(std::move(owned))) {}
+
+    int doc() const override { return pos_ < list_->size() ? (*list_)[pos_] : END_OF_STREAM; }
+    void next() override { ++pos_; }
+    void advance(int target) override {
+        pos_ = std::lower_bound(list_->begin() + pos_, list_->end(), target) - list_->begin();
+    }
+
+private:
+    PostingList list_;
+    size_t pos_ = 0;
+};
+
+class AndStream : public DocStream {
+public:
+    AndStream(std::unique_ptr<DocStream> a, std::unique_ptr<DocStream> b) : a_(std::move(a)), b_(std::move(b)) { align(); }
+    int doc() const override { return a_->doc(); }
+    void next() override {
+        a_->next();
+        align();
+    }
+    void advance(int target) override {
+        a_->advance(target);
+        align();
+    }
+
+private:
+    void align() {
+        while (a_->doc() != END_OF_STREAM && a_->doc() != b_->doc()) {
+            if (a_->doc() < b_->doc()) {
+                a_->advance(b_->doc());
+            } else {
+                b_->advance(a_->doc());
+            }
+        }
+    }
+    std::unique_ptr<DocStream> a_, b_;
+};
+
+class AndNotStream : public DocStream {
+public:
+    AndNotStream(std::unique_ptr<DocStream> a, std::unique_ptr<DocStream> b) : a_(std::move(a)), b_(std::move(b)) { skip(); }
+    int doc() const override { return a_->doc(); }
+    void next() override {
+        a_->next();
+        skip();
+    }
+    void advance(int target) override {
+        a_->advance(target);
+        skip();
+    }
+
+private:
+    void skip() {
+        while (a_->doc() != END_OF_STREAM) {
+            b_->advance(a_->doc());
+            if (b_->doc() != a_->doc()) return;
+            a_->next();
+        }
+    }
+    std::unique_ptr<DocStream> a_, b_;
+};
+
+// объединение любого числа потоков (OR и слияние сегментов)
+class OrStream : public DocStream {
+public:
+    explicit OrStream(std::vector<std::unique_ptr<DocStream>> parts) : parts_(std::move(parts)) { update(); }
+    int doc() const override { return current_; }
+    void next() override {
+        for (auto& p : parts_) {
+            if (p->doc() == current_) p->next();
+        }
+        update();
+    }
+    void advance(int target) override {
+        for (auto& p : parts_) p->advance(target);
+        update();
+    }
+
+private:
+    void update() {
+        current_ = END_OF_STREAM;
+        for (auto& p : parts_) current_ = std::min(current_, p->doc());
+    }
+    std::vector<std::unique_ptr<DocStream>> parts_;
+    int current_ = END_OF_STREAM;
+};
+
+class LiveDocsStream : public DocStream {
+public:
+    LiveDocsStream(std::unique_ptr<DocStream> in, const std::vector<uint8_t>& deleted) : in_(std::move(in)), deleted_(deleted) { skip(); }
+    int doc() const override { return in_->doc(); }
+    void next() override {
+        in_->next();
+        skip();
+    }
+    void advance(int target) override {
+        in_->advance(target);
+        skip();
+    }
+
+private:
+    void skip() {
+        while (in_->doc() != END_OF_STREAM && is_tombstoned(deleted_, in_->doc())) in_->next();
+    }
+    std::unique_ptr<DocStream> in_;
+    const std::vector<uint8_t>& deleted_;
+};
+
+// --collapse-duplicates для потока: doc_id, кластер которого уже встречался, пропускается
+class CollapseStream : public DocStream {
+public:
+    CollapseStream(std::unique_ptr<DocStream> in, const DuplicateTable& duplicates) : in_(std::move(in)), duplicates_(duplicates) { skip(); }
+    int doc() const override { return in_->doc(); }
+    void next() override {
+        in_->next();
+        skip();
+    }
+    void advance(int target) override {
+        in_->advance(target);
+        skip();
+    }
+
+private:
+    void skip() {
+        while (in_->doc() != END_OF_STREAM && !seen_.insert(duplicates_.representative(in_->doc())).second) in_->next();
+    }
+    std::unique_ptr<DocStream> in_;
+    const DuplicateTable& duplicates_;
+    std::unordered_set<int> seen_;
+};
+
+// фильтр атрибутов поверх потока: keep = true - пропускаются документы, не проходящие фильтр,
+// false - проходящие (AND NOT)
+class FilterStream : public DocStream {
+public:
+    FilterStream(std::unique_ptr<DocStream> in, AttributeFilter filter, const DocAttributes& attributes, bool keep)
+        : in_(std::move(in)), filter_(std::move(filter)), attributes_(attributes), keep_(keep) { skip(); }
+    int doc() const override { return in_->doc(); }
+    void next() override {
+        in_->next();
+        skip();
+    }
+    void advance(int target) override {
+        in_->advance(target);
+        skip();
+    }
+
+private:
+    void skip() {
+        while (in_->doc() != END_OF_STREAM && filter_.matches(attributes_, in_->doc()) != keep_) in_->next();
+    }
+    std::unique_ptr<DocStream> in_;
+    AttributeFilter filter_;
+    const DocAttributes& attributes_;
+    bool keep_;
+};
+
+std::unique_ptr<DocStream> build_stream(const QueryNode& node, const Segment& seg) {
+    if (is_filter(node)) return std::make_unique<ListStream>(filter_docs(node, seg));
+    if (node.type == QueryNode::AND && is_filter(node.children[0])) {
+        return std::make_unique<FilterStream>(build_stream(node.children[1], seg),
+                                              compile_filter(node.children[0], seg), seg.attributes, true);
+    }
+    if ((node.type == QueryNode::AND || node.type == QueryNode::AND_NOT) && is_filter(node.children[1])) {
+        return std::make_unique<FilterStream>(build_stream(node.children[0], seg), compile_filter(node.children[1], seg),
+                                              seg.attributes, node.type == QueryNode::AND);
+    }
+    switch (node.type) {
+        case QueryNode::TERM:
+            return std::make_unique<ListStream>(get_postings(seg, node.terms[0]));
+        case QueryNode::WILDCARD:
+            return std::make_unique<ListStream>(wildcard_postings(seg, node.terms[0]));
+        case QueryNode::FUZZY:
+            return std::make_unique<ListStream>(fuzzy_postings(seg, node.terms[0], node.distance));
+        case QueryNode::PHRASE:
+        case QueryNode::NEAR:
+            return std::make_unique<ListStream>(evaluate_positional(node, seg).docs);
+        case QueryNode::AND:
+            return std::make_unique<AndStream>(build_stream(node.children[0], seg), build_stream(node.children[1], seg));
+        case QueryNode::AND_NOT:
+            return std::make_unique<AndNotStream>(build_stream(node.children[0], seg), build_stream(node.children[1], seg));
+        case QueryNode::OR: {
+            std::vector<std::unique_ptr<DocStream>> parts;
+            parts.push_back(build_stream(node.children[0], seg));
+            parts.push_back(build_stream(node.children[1], seg));
+            return std::make_unique<OrStream>(std::move(parts));
+        }
+        case QueryNode::SOURCE:
+        case QueryNode::DATE:
+            break;
+    }
+    return std::make_unique<ListStream>(std::vector<int>());
+}
+
+// поток результатов по всем сегментам снимка
+std::unique_ptr<DocStream> open_query_stream(const QueryNode& root, const IndexSnapshot& snapshot) {
+    std::vector<std::unique_ptr<DocStream>> parts;
+    for (const auto& seg : snapshot.segments) {
+        if (!seg.db_ids.empty()) {
+            // внутренний порядок перенумерованного индекса не совпадает с порядком id в базе
+            parts.push_back(std::make_unique<ListStream>(to_db_ids(evaluate(root, seg), seg)));
+            continue;
+        }
+        parts.push_back(std::make_unique<LiveDocsStream>(build_stream(root, seg), seg.deleted));
+    }
+    auto merged = std::make_unique<OrStream>(std::move(parts));
+    if (!collapse_duplicates || snapshot.duplicates.empty()) return merged;
+    return std::make_unique<CollapseStream>(std::move(merged), snapshot.duplicates);
+}
+
+void print_doc_rows(const std::vector<DocInfo>& rows) {
+    StageTimer timer(query_stats, STAGE_OUTPUT);
+    for (const auto& r : rows) {
+        std::cout << "[id: " << r.id << "] " << r.title << " — " << r.normalized_url << "\n";
+    }
+    std::cout.flush();
+}
+
+// числовой аргумент флага: вся строка - целое число от min_value до max_value
+bool parse_int_arg(const std::string& text, long long min_value, long long max_value, long long& value) {
+    try {
+        size_t used = 0;
+        value = std::stoll(text, &used);
+        if (used != text.size()) return false;
+    } catch (const std::logic_error&) {
+        return false;
+    }
+    return value >= min_value && value <= max_value;
+}
+
+bool parse_rate_arg(const std::string& text, double& value) {
+    try {
+        size_t used = 0;
+        value = std::stod(text, &used);
+        if (used != text.size()) return false;
+    } catch (const std::logic_error&) {
+        return false;
+    }
+    return std::isfinite(value) && value >= 0.0;
+}
+
+void print_usage() {
+    std::cerr << "Использование:\n"
+                 "  searcher.exe [--ids-only] [--page-size N] [--cache-mb N] [--postings-cache-mb N]\n"
+                 "               [--max-expansion N] [--collapse-duplicates] [--stats] [--warmup queries.log]\n"
+                 "  searcher.exe --serve [--port N] [--threads N] ...\n"
+                 "  searcher.exe --bench queries.txt [--threads N] [--requests N] [--rate QPS] ...\n"
+                 "  searcher.exe --coordinator [--shard host:port ...] [--port N] [--threads N] [--shard-timeout-ms N]\n";
+}
+
+// полный режим с базой: метаданные первых PREFETCH_PAGES страниц запрашиваются по мере того,
+// как поток результатов выдаёт их doc_id, и идут из базы, пока слияние продолжается.
+// prefetched - полученные страницы
+const size_t PREFETCH_PAGES = 2;
+
+std::vector<int> stream_query_with_metadata(const std::string& raw_query, const IndexSnapshot& snapshot,
+                                            QueryCache& cache, size_t page_size, DBPool& pool,
+                                            std::vector<std::vector<DocInfo>>& prefetched) {
+    prefetched.clear();
+    QueryNode root;
+    if (!parse_query(raw_query, snapshot.segments, root)) return {};
+
+    // при попадании в кэш поток не нужен: все doc_id уже известны
+    std::string key = cache.enabled() ? canonical_query(root) : "";
+    std::vector<int> ids;
+    bool cached = cache.enabled() && cache.get(key, snapshot.version, ids);
+    auto stream = cached ? nullptr : open_query_stream(root, snapshot);
+
+    MetadataPipeline pipeline(pool);
+    // слияние потоков - set_ops, отправка запросов метаданных по ходу слияния и ожидание ответов - metadata
+    StageClock set_ops_clock(query_stats, STAGE_SET_OPS);
+    StageClock metadata_clock(query_stats, STAGE_METADATA);
+    set_ops_clock.start();
+    for (; stream && stream->doc() != END_OF_STREAM; stream->next()) {
+        ids.push_back(stream->doc());
+        if (ids.size() % page_size == 0 && pipeline.requested() < PREFETCH_PAGES) {
+            set_ops_clock.stop();
+            metadata_clock.start();
+            pipeline.request(std::vector<int>(ids.end() - page_size, ids.end()));
+            metadata_clock.stop();
+            set_ops_clock.start();
+        }
+    }
+    set_ops_clock.stop();
+    if (!cached && cache.enabled()) cache.put(key, snapshot.version, ids);
+
+    metadata_clock.start();
+    while (pipeline.requested() < PREFETCH_PAGES && ids.size() > pipeline.requested() * page_size) {
+        size_t begin = pipeline.requested() * page_size;
+        size_t end = std::min(begin + page_size, ids.size());
+        pipeline.request(std::vector<int>(ids.begin() + begin, ids.begin() + end));
+    }
+    pipeline.wait_all();
+    metadata_clock.stop();
+    for (size_t page = 0; page < pipeline.requested(); ++page) {
+        prefetched.push_back(pipeline.page(page));
+    }
+    return ids;
+}
+
+// режим сервера: цикл событий принимает соединения и читает строки,
+// запросы выполняют рабочие потоки над общим неизменяемым снимком индекса
+
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t threads) {
+        for (size_t i = 0; i < threads; ++i) {
+            workers_.emplace_back([this] { run(); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            tasks_.push_back(std::move(task));
+        }
+        wake_.notify_one();
+    }
+
+private:
+    void run() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> guard(lock_);
+                wake_.wait(guard, [this] { return stop_ || !tasks_.empty(); });
+                if (stop_ && tasks_.empty()) return;
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex lock_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+};
+
+// запросы одного соединения выполняются по очереди, чтобы ответы шли в порядке запросов
+struct Connection {
+    socket_t fd;
+    std::string input;                 // только поток цикла событий
+    std::mutex lock;
+    std::deque<std::string> pending;
+    bool busy = false;
+    std::atomic<bool> closed{false};
+
+    explicit Connection(socket_t s) : fd(s) {}
+    ~Connection() { close_socket(fd); }
+};
+
+// общее состояние сервера для рабочих потоков
+struct ServerState {
+    const IndexHolder& index;
+    QueryCache& cache;
+    ShardCoordinator* coordinator = nullptr;     // --coordinator: запросы уходят шардам, индекс не загружен
+    const DuplicateTable* duplicates = nullptr;  // --coordinator --collapse-duplicates
+};
+
+// счётчики кэшей и, с --stats, перцентили этапов; строки разделяются separator
+std::string format_stats(const QueryCacheStats& s, const std::string& separator) {
+    PostingCacheStats p = posting_cache.stats();
+    std::ostringstream out;
+    out << "cache hits=" << s.hits << " misses=" << s.misses << " evictions=" << s.evictions
+        << " entries=" << s.entries << " bytes=" << s.bytes << "/" << s.capacity << separator
+        << "postings hits=" << p.hits << " misses=" << p.misses << " rejected=" << p.rejected
+        << " evictions=" << p.evictions << " entries=" << p.entries << " bytes=" << p.bytes << "/" << p.capacity;
+    if (query_stats.enabled()) {
+        for (const auto& line : query_stats.report()) out << separator << line;
+    }
+    return out.str();
+}
+
+// подсказки по префиксу без чтения posting листов: готовые списки лучших терминов сегментов
+// (suggest.h). Кандидаты - термины из списков всех сегментов (до SUGGEST_MERGE_K с каждого),
+// вес кандидата - сумма числа документов по всем сегментам, в том числе тем, где он не в списке.
+// limit - сколько терминов вернуть (не больше SUGGEST_MERGE_K)
+std::vector<std::pair<std::string, uint32_t>> suggest_terms(const IndexSnapshot& snapshot, const std::string& prefix,
+                                                            uint32_t limit = SUGGEST_TOP_K) {
+    std::vector<std::string> candidates;
+    for (const auto& seg : snapshot.segments) {
+        const std::vector<IndexEntry>& postings = seg.index.postings;
+        auto weight = [&postings](uint32_t t) { return postings[t].doc_count; };
+        for (uint32_t t : seg.completion.complete(seg.index.terms, prefix, weight)) {
+            candidates.push_back(seg.index.terms.term(t));
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    std::vector<std::pair<std::string, uint32_t>> result;
+    for (auto& term : candidates) {
+        uint32_t weight = 0;
+        for (const auto& seg : snapshot.segments) {
+            long long idx = seg.index.terms.find(term);
+            if (idx >= 0) weight += seg.index.postings[static_cast<size_t>(idx)].doc_count;
+        }
+        result.emplace_back(std::move(term), weight);
+    }
+    std::sort(result.begin(), result.end(), [](const std::pair<std::string, uint32_t>& a, const std::pair<std::string, uint32_t>& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    if (result.size() > limit) result.resize(limit);
+    return result;
+}
+
+// "suggest <префикс>" -> префикс и limit = SUGGEST_TOP_K; "suggest/<k> <префикс>" - до k терминов
+// (k от 1 до SUGGEST_MERGE_K, так координатор берёт с шардов списки глубже итоговых).
+// false - это не команда подсказок
+bool parse_suggest(const std::string& query, std::string& prefix, uint32_t& limit) {
+    size_t name_end = query.find(' ');
+    std::string name = query.substr(0, name_end);
+    limit = SUGGEST_TOP_K;
+    if (name.rfind("suggest/", 0) == 0) {
+        std::string k = name.substr(8);
+        if (k.empty() || k.size() > 3 || k.find_first_not_of("0123456789") != std::string::npos) return false;
+        limit = static_cast<uint32_t>(std::stoul(k));
+        if (limit < 1 || limit > SUGGEST_MERGE_K) return false;
+    } else if (name != "suggest") {
+        return false;
+    }
+    size_t begin = name_end == std::string::npos ? std::string::npos : query.find_first_not_of(' ', name_end);
+    size_t end = query.find_last_not_of(" \r");
+    prefix = begin == std::string::npos || end < begin ? "" : to_lower(query.substr(begin, end - begin + 1));
+    return true;
+}
+
+// --coordinator: ответы шардов сливаются. Id в базе у шардов не пересекаются, поэтому результат -
+// объединение отсортированных списков; если ответили не все шарды, строка начинается с PARTIAL.
+// Результаты не кэшируются: шарды переиндексируются независимо, общей версии индекса нет
+std::string answer_sharded(const std::string& query, ServerState& state) {
+    ShardCoordinator& coordinator = *state.coordinator;
+    if (query == "stats") {
+        CoordinatorStats s = coordinator.stats();
+        return "STATS shards=" + std::to_string(coordinator.shard_count()) + " queries=" + std::to_string(s.queries) +
+               " partial=" + std::to_string(s.partial) + " timeouts=" + std::to_string(s.timeouts) +
+               " unavailable=" + std::to_string(s.unavailable) + "\n";
+    }
+    std::string prefix;
+    uint32_t limit = SUGGEST_TOP_K;
+    bool suggest = parse_suggest(query, prefix, limit);
+    // у шардов подсказки берутся с запасом: термин, лучший в сумме, может не войти в первые limit ни одного шарда
+    std::vector<ShardReply> replies =
+        coordinator.scatter(suggest ? "suggest/" + std::to_string(SUGGEST_MERGE_K) + " " + prefix : query);
+
+    size_t answered = 0;
+    std::vector<std::vector<int>> lists;
+    std::vector<std::pair<std::string, uint32_t>> suggestions;
+    for (const auto& reply : replies) {
+        if (!reply.answered) continue;
+        std::istringstream in(reply.line);
+        std::string status;
+        size_t count = 0;
+        in >> status >> count;
+        // ошибка разбора запроса одинакова на всех шардах
+        if (status == "ERR") return reply.line + "\n";
+        if (suggest && status == "SUGGEST") {
+            // веса одного термина из разных шардов складываются. Это приближение: термин, который
+            // у какого-то шарда не вошёл в его SUGGEST_MERGE_K лучших, получает вес без этого шарда
+            // (а при малом весе во всех шардах может не попасть в ответ совсем)
+            std::string item;
+            while (in >> item) {
+                size_t colon = item.rfind(':');
+                if (colon == std::string::npos) continue;
+                std::string term = item.substr(0, colon);
+                uint32_t weight = static_cast<uint32_t>(std::stoul(item.substr(colon + 1)));
+                auto it = std::find_if(suggestions.begin(), suggestions.end(),
+                                       [&term](const std::pair<std::string, uint32_t>& r) { return r.first == term; });
+                if (it == suggestions.end()) {
+                    suggestions.emplace_back(term, weight);
+                } else {
+                    it->second += weight;
+                }
+            }
+        } else if (!suggest && status == "OK") {
+            std::vector<int> ids(count);
+            for (int& id : ids) in >> id;
+            if (!in) continue;
+            lists.push_back(std::move(ids));
+        } else {
+            continue;
+        }
+        ++answered;
+    }
+    if (answered == 0) return "ERR Шарды не ответили.\n";
+
+    if (suggest) {
+        std::sort(suggestions.begin(), suggestions.end(),
+                  [](const std::pair<std::string, uint32_t>& a, const std::pair<std::string, uint32_t>& b) {
+                      return a.second != b.second ? a.second > b.second : a.first < b.first;
+                  });
+        if (suggestions.size() > limit) suggestions.resize(limit);
+        std::string out = "SUGGEST " + std::to_string(suggestions.size());
+        for (const auto& s : suggestions) out += " " + s.first + ":" + std::to_string(s.second);
+        return out + "\n";
+    }
+
+    std::vector<const std::vector<int>*> parts;
+    for (const auto& list : lists) parts.push_back(&list);
+    std::vector<int> docs = union_many(parts);
+    if (state.duplicates) docs = collapse_duplicate_docs(docs, *state.duplicates);
+    std::string out = (answered < coordinator.shard_count() ? "PARTIAL " : "OK ") + std::to_string(docs.size());
+    for (int id : docs) {
+        out += ' ';
+        out += std::to_string(id);
+    }
+    out += '\n';
+    return out;
+}
+
+std::string answer_query(const std::string& query, ServerState& state) {
+    if (state.coordinator) return answer_sharded(query, state);
+    if (query == "stats") return "STATS " + format_stats(state.cache.stats(), "; ") + "\n";
+    std::string prefix;
+    uint32_t limit = SUGGEST_TOP_K;
+    if (parse_suggest(query, prefix, limit)) {
+        auto suggestions = suggest_terms(*state.index.get(), prefix, limit);
+        std::string out = "SUGGEST " + std::to_string(suggestions.size());
+        for (const auto& s : suggestions) out += " " + s.first + ":" + std::to_string(s.second);
+        return out + "\n";
+    }
+    auto snapshot = state.index.get();
+    std::string error;
+    std::vector<int> docs = execute_query(query, *snapshot, &error, &state.cache);
+    if (!error.empty()) return "ERR " + error + "\n";
+
+    StageTimer timer(query_stats, STAGE_OUTPUT);
+    std::string out = "OK " + std::to_string(docs.size());
+    for (int id : docs) {
+        out += ' ';
+        out += std::to_string(id);
+    }
+    out += '\n';
+    return out;
+}
+
+void serve_connection(const std::shared_ptr<Connection>& conn, ServerState& state) {
+    while (true) {
+        std::string query;
+        {
+            std::lock_guard<std::mutex> guard(conn->lock);
+            if (conn->pending.empty() || conn->closed) {
+                conn->busy = false;
+                return;
+            }
+            query = std::move(conn->pending.front());
+            conn->pending.pop_front();
+        }
+        std::string response = answer_query(query, state);
+        StageTimer timer(query_stats, STAGE_OUTPUT);
+        if (!send_all(conn->fd, response)) {
+            conn->closed = true;
+        }
+    }
+}
+
+// дочитывает доступные данные; false - соединение закрыто
+bool read_connection(const std::shared_ptr<Connection>& conn, WorkerPool& pool, ServerState& state) {
+    char chunk[4096];
+    while (true) {
+        int n = recv(conn->fd, chunk, sizeof(chunk), 0);
+        if (n > 0) {
+            conn->input.append(chunk, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && last_error_would_block()) break;
+        return false;
+    }
+
+    size_t start = 0, nl;
+    bool submit = false;
+    {
+        std::lock_guard<std::mutex> guard(conn->lock);
+        while ((nl = conn->input.find('\n', start)) != std::string::npos) {
+            std::string line = conn->input.substr(start, nl - start);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!line.empty()) conn->pending.push_back(std::move(line));
+            start = nl + 1;
+        }
+        if (!conn->busy && !conn->pending.empty()) {
+            conn->busy = true;
+            submit = true;
+        }
+    }
+    conn->input.erase(0, start);
+    if (submit) {
+        pool.submit([conn, &state] { serve_connection(conn, state); });
+    }
+    return true;
+}
+
+socket_t accept_connection(socket_t listener) {
+    socket_t client = accept(listener, nullptr, nullptr);
+    if (client == INVALID_SOCK) return INVALID_SOCK;
+    set_nonblocking(client);
+    set_nodelay(client);
+    return client;
+}
+
+#ifdef __linux__
+void run_event_loop(socket_t listener, WorkerPool& pool, ServerState& state) {
+    int ep = epoll_create1(0);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listener;
+    epoll_ctl(ep, EPOLL_CTL_ADD, listener, &ev);
+
+    std::map<int, std::shared_ptr<Connection>> connections;
+    std::vector<epoll_event> events(256);
+    while (true) {
+        int n = epoll_wait(ep, events.data(), static_cast<int>(events.size()), -1);
+        if (n < 0 && errno == EINTR) continue;
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listener) {
+                socket_t client;
+                while ((client = accept_connection(listener)) != INVALID_SOCK) {
+                    epoll_event cev{};
+                    cev.events = EPOLLIN | EPOLLRDHUP;
+                    cev.data.fd = client;
+                    epoll_ctl(ep, EPOLL_CTL_ADD, client, &cev);
+                    connections[client] = std::make_shared<Connection>(client);
+                }
+                continue;
+            }
+            auto it = connections.find(fd);
+            if (it == connections.end()) continue;
+            if (!read_connection(it->second, pool, state) || (events[i].events & (EPOLLHUP | EPOLLERR))) {
+                epoll_ctl(ep, EPOLL_CTL_DEL, fd, nullptr);
+                it->second->closed = true;
+                connections.erase(it);
+            }
+        }
+    }
+}
+#else
+// без epoll (Windows): WSAPoll по всем соединениям
+void run_event_loop(socket_t listener, WorkerPool& pool, ServerState& state) {
+    std::map<socket_t, std::shared_ptr<Connection>> connections;
+    while (true) {
+        std::vector<pollfd> fds;
+        pollfd lfd{};
+        lfd.fd = listener;
+        lfd.events = POLLIN;
+        fds.push_back(lfd);
+        for (const auto& c : connections) {
+            pollfd pfd{};
+            pfd.fd = c.first;
+            pfd.events = POLLIN;
+            fds.push_back(pfd);
+        }
+        if (poll_sockets(fds.data(), fds.size(), -1) <= 0) continue;
+
+        if (fds[0].revents & POLLIN) {
+            socket_t client;
+            while ((client = accept_connection(listener)) != INVALID_SOCK) {
+                connections[client] = std::make_shared<Connection>(client);
+            }
+        }
+        for (size_t i = 1; i < fds.size(); ++i) {
+            if (!fds[i].revents) continue;
+            auto it = connections.find(fds[i].fd);
+            if (it == connections.end()) continue;
+            if (!read_connection(it->second, pool, state) || (fds[i].revents & (POLLHUP | POLLERR))) {
+                it->second->closed = true;
+                connections.erase(it);
+            }
+        }
+    }
+}
+#endif
+
+int run_server(ServerState& state, int port, size_t threads) {
+    if (!net_init()) {
+        std::cerr << "Не удалось инициализировать сокеты\n";
+        return 1;
+    }
+    socket_t listener = listen_tcp(port);
+    if (listener == INVALID_SOCK) {
+        std::cerr << "Не удалось открыть порт " << port << "\n";
+        return 1;
+    }
+    set_nonblocking(listener);
+
+    WorkerPool pool(threads);
+    std::cout << "Сервер запущен: 127.0.0.1:" << port << ", рабочих потоков: " << threads << "\n";
+    run_event_loop(listener, pool, state);
+    close_socket(listener);
+    return 0;
+}
+
+// --coordinator: шарды из --shard host:port; без них - все шарды из shards/shards.txt на этой машине,
+// шард i на порту port + 1 + i
+int run_coordinator(const std::vector<std::string>& shard_specs, int port, size_t threads, int timeout_ms) {
+    std::vector<ShardAddress> shards;
+    if (shard_specs.empty()) {
+        ShardManifest manifest;
+        if (!read_shard_manifest(SHARDS_MANIFEST, manifest)) {
+            std::cerr << "Шарды не заданы: нет --shard и " << SHARDS_MANIFEST << "\n";
+            return 1;
+        }
+        for (size_t i = 0; i < manifest.shards.size(); ++i) {
+            ShardAddress address;
+            address.port = port + 1 + static_cast<int>(i);
+            shards.push_back(address);
+        }
+    }
+    for (const auto& spec : shard_specs) {
+        ShardAddress address;
+        if (!parse_shard_address(spec, address)) {
+            std::cerr << "Неверный адрес шарда: " << spec << "\n";
+            return 1;
+        }
+        shards.push_back(address);
+    }
+
+    ShardCoordinator coordinator(shards, std::chrono::milliseconds(timeout_ms));
+    for (size_t i = 0; i < coordinator.shard_count(); ++i) {
+        std::cout << "Шард " << i << ": " << coordinator.address(i).host << ":" << coordinator.address(i).port << "\n";
+    }
+    std::cout << "Ожидание ответа шарда: " << timeout_ms << " мс\n";
+    DuplicateTable duplicates;
+    if (collapse_duplicates) {
+        duplicates.load(DUPLICATES_FILE);
+        std::cout << "Почти одинаковых документов в " << DUPLICATES_FILE << ": " << duplicates.size() << "\n";
+    }
+
+    IndexHolder index(nullptr);
+    QueryCache cache(0);
+    ServerState state{index, cache};
+    state.coordinator = &coordinator;
+    state.duplicates = collapse_duplicates ? &duplicates : nullptr;
+    return run_server(state, port, threads);
+}
+
+// пакетный прогон запросов из файла (--bench): без консоли и базы, только вычисление по индексу.
+// Замкнутый цикл: каждый поток берёт следующий запрос, как только выполнил предыдущий.
+// Открытый цикл (--rate): запросы поступают по расписанию с постоянной частотой, задержка
+// считается от запланированного момента, поэтому очередь при перегрузке тоже попадает в перцентили.
+
+std::vector<std::string> read_queries(const std::string& path) {
+    std::vector<std::string> queries;
+    std::ifstream file(path, std::ios::binary);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) queries.push_back(line);
+    }
+    return queries;
+}
+
+enum QueryShape { SHAPE_SINGLE, SHAPE_AND, SHAPE_OR, SHAPE_AND_NOT, SHAPE_POSITIONAL, SHAPE_MIXED, SHAPE_INVALID,
+                  SHAPE_COUNT };
+
+const char* const SHAPE_NAMES[SHAPE_COUNT] = {"single", "and", "or", "and not", "phrase/near", "mixed", "invalid"};
+
+void collect_operators(const QueryNode& node, std::vector<bool>& seen) {
+    seen[node.type] = true;
+    for (const auto& child : node.children) collect_operators(child, seen);
+}
+
+// вид запроса по операторам дерева; разбор без parse_query, чтобы не трогать статистику и журнал
+QueryShape query_shape(const std::string& raw_query) {
+    std::vector<std::string> tokens = lex_query(raw_query);
+    if (tokens.empty()) return SHAPE_INVALID;
+    QueryParser parser(tokens);
+    QueryNode root = parser.parse_or();
+    if (!parser.ok || !parser.at_end()) return SHAPE_INVALID;
+
+    std::vector<bool> seen(QueryNode::DATE + 1, false);
+    collect_operators(root, seen);
+    if (seen[QueryNode::PHRASE] || seen[QueryNode::NEAR]) return SHAPE_POSITIONAL;
+    int operators = seen[QueryNode::AND] + seen[QueryNode::OR] + seen[QueryNode::AND_NOT];
+    if (operators == 0) return SHAPE_SINGLE;
+    if (operators > 1) return SHAPE_MIXED;
+    if (seen[QueryNode::AND]) return SHAPE_AND;
+    return seen[QueryNode::OR] ? SHAPE_OR : SHAPE_AND_NOT;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t idx = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[idx];
+}
+
+struct BenchSample {
+    QueryShape shape;
+    double latency_us;
+    size_t results;
+    bool error;
+};
+
+// requests запросов по кругу из файла; rate > 0 - открытый цикл с rate запросами в секунду
+int run_bench(const IndexHolder& index, QueryCache& cache, const std::string& path, size_t threads,
+              size_t requests, double rate) {
+    std::vector<std::string> queries = read_queries(path);
+    if (queries.empty()) {
+        std::cerr << "Файл запросов пуст: " << path << "\n";
+        return 1;
+    }
+    if (requests == 0) requests = queries.size();
+    if (threads == 0) threads = 1;
+    std::vector<QueryShape> shapes;
+    for (const auto& q : queries) shapes.push_back(query_shape(q));
+
+    std::vector<std::vector<BenchSample>> samples(threads);
+    std::atomic<size_t> next_request{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            while (true) {
+                size_t n = next_request++;
+                if (n >= requests) break;
+                auto t0 = std::chrono::steady_clock::now();
+                if (rate > 0) {
+                    auto scheduled = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                 std::chrono::duration<double>(n / rate));
+                    if (scheduled > t0) std::this_thread::sleep_until(scheduled);
+                    t0 = scheduled;
+                }
+                const std::string& query = queries[n % queries.size()];
+                std::string error;
+                std::vector<int> docs = execute_query(query, *index.get(), &error, &cache);
+                auto t1 = std::chrono::steady_clock::now();
+                samples[t].push_back({shapes[n % queries.size()],
+                                      std::chrono::duration<double, std::micro>(t1 - t0).count(), docs.size(),
+                                      !error.empty()});
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> all;
+    std::vector<std::vector<double>> by_shape(SHAPE_COUNT);
+    std::vector<size_t> results(SHAPE_COUNT, 0), errors(SHAPE_COUNT, 0);
+    size_t total_errors = 0;
+    for (const auto& thread_samples : samples) {
+        for (const auto& s : thread_samples) {
+            all.push_back(s.latency_us);
+            by_shape[s.shape].push_back(s.latency_us);
+            results[s.shape] += s.results;
+            if (s.error) {
+                ++errors[s.shape];
+                ++total_errors;
+            }
+        }
+    }
+    std::sort(all.begin(), all.end());
+    for (auto& l : by_shape) std::sort(l.begin(), l.end());
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Режим: " << (rate > 0 ? "открытый цикл, " + std::to_string(static_cast<long long>(rate)) + " запросов/с"
+                                        : std::string("замкнутый цикл"))
+              << ", потоков: " << threads << "\n";
+    std::cout << "Запросов выполнено: " << all.size() << " (ошибок: " << total_errors << "), время: " << elapsed
+              << " сек\n";
+    std::cout << "QPS: " << (elapsed > 0 ? all.size() / elapsed : 0.0) << "\n";
+    std::cout << "Задержка p50: " << percentile(all, 0.50) << " мкс, p90: " << percentile(all, 0.90)
+              << " мкс, p99: " << percentile(all, 0.99) << " мкс, p99.9: " << percentile(all, 0.999)
+              << " мкс, max: " << (all.empty() ? 0.0 : all.back()) << " мкс\n";
+    std::cout << "\nВид запроса     запросов  ошибок  документов (сред.)  p50 мкс    p99 мкс\n";
+    for (int s = 0; s < SHAPE_COUNT; ++s) {
+        const auto& l = by_shape[s];
+        if (l.empty()) continue;
+        size_t answered = l.size() - errors[s];
+        std::cout << std::left << std::setw(16) << SHAPE_NAMES[s] << std::right << std::setw(8) << l.size()
+                  << std::setw(8) << errors[s] << std::setw(20)
+                  << (answered > 0 ? static_cast<double>(results[s]) / answered : 0.0) << std::setw(11)
+                  << percentile(l, 0.50) << std::setw(11) << percentile(l, 0.99) << "\n";
+    }
+    return all.empty() ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    setup_utf8_console();
+
+    bool ids_only_mode = false;
+    bool serve_mode = false;
+    int port = DEFAULT_SERVE_PORT;
+    size_t page_size = 20;
+    size_t cache_mb = 64;
+    size_t postings_cache_mb = 256;
+    std::string warmup_path;
+    bool stats_mode = false;
+    std::string bench_path;
+    size_t bench_requests = 0;
+    double bench_rate = 0.0;
+    size_t threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 4;
+    bool coordinator_mode = false;
+    std::vector<std::string> shard_specs;
+    int shard_timeout_ms = DEFAULT_SHARD_TIMEOUT_MS;
+    long long number = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        // значение флага - следующий аргумент; неверное число - сообщение и справка вместо исключения
+        auto int_arg = [&](long long min_value, long long max_value) {
+            if (parse_int_arg(argv[++i], min_value, max_value, number)) return true;
+            std::cerr << arg << ": ожидается целое число от " << min_value << " до " << max_value << "\n";
+            print_usage();
+            return false;
+        };
+        if (arg == "--ids-only") {
+            ids_only_mode = true;
+        } else if (arg == "--serve") {
+            serve_mode = true;
+        } else if (arg == "--page-size" && i + 1 < argc) {
+            if (!int_arg(1, 1000000)) return 1;
+            page_size = static_cast<size_t>(number);
+        } else if (arg == "--port" && i + 1 < argc) {
+            if (!int_arg(1, 65535)) return 1;
+            port = static_cast<int>(number);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            if (!int_arg(1, 1024)) return 1;
+            threads = static_cast<size_t>(number);
+        } else if (arg == "--cache-mb" && i + 1 < argc) {
+            if (!int_arg(0, 1 << 20)) return 1;
+            cache_mb = static_cast<size_t>(number);
+        } else if (arg == "--stats") {
+            stats_mode = true;
+        } else if (arg == "--warmup" && i + 1 < argc) {
+            warmup_path = argv[++i];
+        } else if (arg == "--bench" && i + 1 < argc) {
+            bench_path = argv[++i];
+        } else if (arg == "--requests" && i + 1 < argc) {
+            if (!int_arg(0, 1000000000)) return 1;
+            bench_requests = static_cast<size_t>(number);
+        } else if (arg == "--rate" && i + 1 < argc) {
+            if (!parse_rate_arg(argv[++i], bench_rate)) {
+                std::cerr << "--rate: ожидается неотрицательное число запросов в секунду\n";
+                print_usage();
+                return 1;
+            }
+        } else if (arg == "--postings-cache-mb" && i + 1 < argc) {
+            if (!int_arg(0, 1 << 20)) return 1;
+            postings_cache_mb = static_cast<size_t>(number);
+        } else if (arg == "--max-expansion" && i + 1 < argc) {
+            if (!int_arg(0, 1000000000)) return 1;
+            max_expansion = static_cast<size_t>(number);
+        } else if (arg == "--collapse-duplicates") {
+            collapse_duplicates = true;
+        } else if (arg == "--coordinator") {
+            coordinator_mode = true;
+        } else if (arg == "--shard" && i + 1 < argc) {
+            shard_specs.push_back(argv[++i]);
+        } else if (arg == "--shard-timeout-ms" && i + 1 < argc) {
+            if (!int_arg(1, 3600000)) return 1;
+            shard_timeout_ms = static_cast<int>(number);
+        } else {
+            std::cerr << "Неизвестный флаг или нет значения: " << arg << "\n";
+            print_usage();
+            return 1;
+        }
+    }
+
+    if (coordinator_mode) return run_coordinator(shard_specs, port, threads, shard_timeout_ms);
+
+    posting_cache.set_capacity(postings_cache_mb * 1024 * 1024);
+    if (stats_mode) query_stats.enable();
+    std::cout << "Загрузка индекса.\n";
+    IndexHolder index(load_snapshot());
+    if (!index.get()) return 1;
+    std::cout << "Версия индекса: " << index.get()->version << ", сегментов: " << index.get()->segments.size() << "\n";
+    if (collapse_duplicates) {
+        std::cout << "Почти одинаковых документов в " << DUPLICATES_FILE << ": " << index.get()->duplicates.size() << "\n";
+    }
+    size_t dict_terms = 0, dict_bytes = 0, trigram_bytes = 0, suggest_bytes = 0, attribute_bytes = 0;
+    for (const auto& seg : index.get()->segments) {
+        dict_terms += seg.index.terms.size();
+        dict_bytes += seg.index.terms.memory_bytes();
+        trigram_bytes += seg.trigrams.memory_bytes();
+        suggest_bytes += seg.completion.memory_bytes();
+        attribute_bytes += seg.attributes.memory_bytes();
+    }
+    std::cout << "Словарь: " << dict_terms << " терминов, " << dict_bytes / 1024 << " КБ, триграммы: "
+              << trigram_bytes / 1024 << " КБ, подсказки: " << suggest_bytes / 1024 << " КБ, атрибуты: "
+              << attribute_bytes / 1024 << " КБ\n";
+    IndexWatcher watcher(index, std::chrono::milliseconds(2000));
+    QueryCache cache(cache_mb * 1024 * 1024);
+
+    // прогрев идёт в фоне, поиск доступен сразу
+    std::thread warmer;
+    if (!warmup_path.empty()) {
+        query_log.start(warmup_path);
+        warmer = std::thread(warm_up, index.get(), query_log.top_terms());
+    }
+    if (!bench_path.empty()) {
+        // прогрев до замера, чтобы он не смешивался с запросами
+        if (warmer.joinable()) warmer.join();
+        int code = run_bench(index, cache, bench_path, threads, bench_requests, bench_rate);
+        query_log.stop();
+        if (stats_mode) std::cerr << format_stats(cache.stats(), "\n") << "\n";
+        return code;
+    }
+    if (serve_mode) {
+        ServerState state{index, cache};
+        int code = run_server(state, port, threads);
+        if (warmer.joinable()) warmer.join();
+        return code;
+    }
+    // заголовки и ссылки берутся из docstore.bin, база нужна только если его нет
+    DocStore docstore;
+    std::thread docstore_warmer;
+    std::unique_ptr<DBPool> db;
+    if (!ids_only_mode) {
+        if (docstore.open("docstore.bin")) {
+            std::cout << "Метаданные: docstore.bin (" << docstore.doc_count() << " doc_id)\n";
+            if (!warmup_path.empty()) docstore_warmer = std::thread([&docstore] { docstore.prefetch(); });
+        } else {
+            DBConfig cfg = load_db_config();
+            db = std::make_unique<DBPool>(cfg, 1);
+        }
+    }
+
+    if (ids_only_mode) {
+        std::cout << "Режим: только ID. Введите запрос:\n";
+    } else {
+        std::cout << "\nВведите запрос:\n";
+    }
+
+    // результаты последнего запроса, сколько из них уже показано и заранее полученные страницы
+    std::vector<int> doc_ids;
+    size_t shown = 0;
+    std::vector<std::vector<DocInfo>> prefetched;
+
+    std::string query;
+    while (std::getline(std::cin, query)) {
+        if (query == "exit") break;
+        if (query == "stats") {
+            std::cout << format_stats(cache.stats(), "\n") << "\n\nВведите запрос:\n";
+            continue;
+        }
+        std::string prefix;
+        uint32_t limit = SUGGEST_TOP_K;
+        if (parse_suggest(query, prefix, limit)) {
+            for (const auto& s : suggest_terms(*index.get(), prefix, limit)) {
+                std::cout << s.first << " (" << s.second << ")\n";
+            }
+            std::cout << "\nВведите запрос:\n";
+            continue;
+        }
+
+        if (query.empty()) {
+            if (ids_only_mode || shown >= doc_ids.size()) continue;
+        } else {
+            auto snapshot = index.get();
+            if (db) {
+                doc_ids = stream_query_with_metadata(query, *snapshot, cache, page_size, *db, prefetched);
+            } else {
+                doc_ids = execute_query(query, *snapshot, nullptr, &cache);
+                prefetched.clear();
+            }
+            shown = 0;
+            if (doc_ids.empty()) {
+                if (!ids_only_mode) {
+                    std::cout << "Ничего не найдено.\n\n";
+                }
+                if (!ids_only_mode) {
+                    std::cout << "\nВведите запрос:\n";
+                }
+                continue;
+            }
+        }
+
+        if (ids_only_mode) {
+            StageTimer timer(query_stats, STAGE_OUTPUT);
+            std::cout << "Найдено: " << doc_ids.size() << " документов\n";
+            for (int id : doc_ids) {
+                std::cout << id << "\n";
+            }
+            std::cout << "Найдено: " << doc_ids.size() << " документов\n";
+            std::cout << "\nВведите запрос:\n";
+        } else {
+            // из базы запрашивается только показываемая страница, если её не получили заранее
+            size_t page_end = std::min(shown + page_size, doc_ids.size());
+            size_t page_no = shown / page_size;
+            std::vector<DocInfo> results;
+            if (page_no < prefetched.size()) {
+                results = prefetched[page_no];
+            } else {
+                std::vector<int> page(doc_ids.begin() + shown, doc_ids.begin() + page_end);
+                results = db ? fetch_metadata(page, *db) : lookup_metadata(page, docstore);
+            }
+            if (shown == 0) {
+                std::cout << "Найдено: " << doc_ids.size() << " документов\n";
+            }
+            print_doc_rows(results);
+            std::cout << "Показаны " << shown + 1 << "-" << page_end << " из " << doc_ids.size() << "\n";
+            shown = page_end;
+            if (shown < doc_ids.size()) {
+                std::cout << "Enter - следующая страница.\n";
+            }
+            std::cout << "\n \n";
+            std::cout << "\nВведите запрос:\n";
+        }
+    }
+
+    if (warmer.joinable()) warmer.join();
+    if (docstore_warmer.joinable()) docstore_warmer.join();
+    query_log.stop();
+    if (stats_mode) std::cerr << format_stats(cache.stats(), "\n") << "\n";
+    return 0;
+}
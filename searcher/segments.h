@@ -0,0 +1,184 @@
+// Сегменты инкрементального индекса (indexer.exe --incremental / --merge, searcher.exe).
+//
+// segments/segments.txt - манифест, переписывается целиком через временный файл:
+//   generation <номер публикации>
+//   next_segment <номер следующего сегмента>
+//   segment <имя> <документов> <файл тумбстоунов или ->
+// Файлы сегмента неизменяемы: <имя>.idx (формат boolean_index.txt), <имя>.docs (doc_id по строке),
+// <имя>.pos (positions.bin, если индекс строился с --positions), <имя>.sug (подсказки, suggest.h),
+// <имя>.attr (атрибуты документов, attributes.h).
+// Тумбстоуны - битовая карта по doc_id, пишется новым файлом <имя>_<generation>.del.
+// segments/indexed.txt - манифест проиндексированных .stems (common/build_manifest.h): размер, хэш
+// и время изменения каждого файла, по нему --incremental находит изменённые документы.
+
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <filesystem>
+#include <cstdint>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+const std::string SEGMENTS_DIR = "segments";
+const std::string SEGMENTS_MANIFEST = "segments/segments.txt";
+const std::string SEGMENTS_LOCK = "segments/LOCK";
+const std::string SEGMENTS_SOURCES = "segments/indexed.txt";
+
+struct SegmentInfo {
+    std::string name;
+    size_t doc_count = 0;
+    std::string tombstones;  // пусто, если удалённых документов нет
+};
+
+struct SegmentManifest {
+    uint64_t generation = 0;
+    uint64_t next_segment = 1;
+    std::vector<SegmentInfo> segments;
+};
+
+inline bool read_manifest(const std::string& path, SegmentManifest& manifest) {
+    std::ifstream in(path);
+    if (!in.is_open()) return false;
+
+    manifest = SegmentManifest();
+    std::string key;
+    while (in >> key) {
+        if (key == "generation") {
+            in >> manifest.generation;
+        } else if (key == "last_indexed") {
+            // водяной знак времени из старых манифестов, теперь изменения ищутся по SEGMENTS_SOURCES
+            long long ignored = 0;
+            in >> ignored;
+        } else if (key == "next_segment") {
+            in >> manifest.next_segment;
+        } else if (key == "segment") {
+            SegmentInfo info;
+            in >> info.name >> info.doc_count >> info.tombstones;
+            if (info.tombstones == "-") info.tombstones.clear();
+            manifest.segments.push_back(info);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool write_manifest(const std::string& path, const SegmentManifest& manifest) {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp);
+        if (!out.is_open()) return false;
+        out << "generation " << manifest.generation << "\n";
+        out << "next_segment " << manifest.next_segment << "\n";
+        for (const auto& seg : manifest.segments) {
+            out << "segment " << seg.name << " " << seg.doc_count << " "
+                << (seg.tombstones.empty() ? "-" : seg.tombstones) << "\n";
+        }
+        if (!out) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    return !ec;
+}
+
+// битовая карта удалённых doc_id
+inline std::vector<uint8_t> read_tombstones(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return {};
+    return std::vector<uint8_t>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+inline bool write_tombstones(const std::string& path, const std::vector<uint8_t>& bitmap) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) return false;
+    out.write(reinterpret_cast<const char*>(bitmap.data()), bitmap.size());
+    return static_cast<bool>(out);
+}
+
+inline bool is_tombstoned(const std::vector<uint8_t>& bitmap, int doc_id) {
+    size_t byte = static_cast<size_t>(doc_id) / 8;
+    return byte < bitmap.size() && (bitmap[byte] >> (doc_id % 8) & 1);
+}
+
+inline void set_tombstone(std::vector<uint8_t>& bitmap, int doc_id) {
+    size_t byte = static_cast<size_t>(doc_id) / 8;
+    if (byte >= bitmap.size()) bitmap.resize(byte + 1, 0);
+    bitmap[byte] |= static_cast<uint8_t>(1 << (doc_id % 8));
+}
+
+// манифест меняют и --incremental, и --merge. Блокировка - каталог LOCK (создание каталога атомарно)
+// с файлом pid владельца; держится только на время чтения, изменения и записи манифеста, само слияние
+// и построение сегмента идут без неё. Блокировка процесса, которого уже нет, снимается.
+const std::string SEGMENTS_LOCK_PID = "segments/LOCK/pid";
+const int SEGMENTS_LOCK_WAIT_MS = 60000;
+const int SEGMENTS_LOCK_ORPHAN_SEC = 10;  // LOCK без pid старше этого - процесс упал сразу после создания
+
+inline long current_pid() {
+#ifdef _WIN32
+    return static_cast<long>(GetCurrentProcessId());
+#else
+    return static_cast<long>(getpid());
+#endif
+}
+
+inline bool process_alive(long pid) {
+#ifdef _WIN32
+    HANDLE h = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(pid));
+    if (!h) return false;
+    DWORD code = 0;
+    bool alive = GetExitCodeProcess(h, &code) && code == STILL_ACTIVE;
+    CloseHandle(h);
+    return alive;
+#else
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+// блокировка осталась от завершившегося процесса
+inline bool segments_lock_stale() {
+    std::ifstream in(SEGMENTS_LOCK_PID);
+    long pid = 0;
+    if (in >> pid) return !process_alive(pid);
+    std::error_code ec;
+    auto created = std::filesystem::last_write_time(SEGMENTS_LOCK, ec);
+    if (ec) return false;
+    return std::filesystem::file_time_type::clock::now() - created > std::chrono::seconds(SEGMENTS_LOCK_ORPHAN_SEC);
+}
+
+inline bool try_lock_segments() {
+    std::error_code ec;
+    if (!std::filesystem::create_directory(SEGMENTS_LOCK, ec)) return false;
+    std::ofstream(SEGMENTS_LOCK_PID) << current_pid() << "\n";
+    return true;
+}
+
+// ждёт освобождения не дольше SEGMENTS_LOCK_WAIT_MS; false - занято дольше
+inline bool lock_segments() {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SEGMENTS_LOCK_WAIT_MS);
+    while (!try_lock_segments()) {
+        if (segments_lock_stale()) {
+            std::cerr << "Снята блокировка завершившегося процесса: " << SEGMENTS_LOCK << "\n";
+            std::error_code ec;
+            std::filesystem::remove_all(SEGMENTS_LOCK, ec);
+            continue;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return true;
+}
+
+inline void unlock_segments() {
+    std::error_code ec;
+    std::filesystem::remove_all(SEGMENTS_LOCK, ec);
+}
@@ -0,0 +1,81 @@
+// Шарды индекса (indexer.exe --shards N, searcher.exe --coordinator).
+//
+// При полной индексации документы делятся на N шардов: по диапазонам id в базе (поровну документов,
+// соседние id - в одном шарде) или по хэшу id (шарды равны по размеру и по нагрузке, даже если
+// новые документы идут в конец диапазона). Каталог shards/<имя> - независимый индекс в формате
+// полной индексации (boolean_index.txt, positions.bin, suggest.bin, doc_ids.txt, attributes.bin),
+// для каждого шарда запускается свой searcher.exe --serve.
+//
+// shards/shards.txt - манифест, переписывается целиком через временный файл:
+//   by range|hash
+//   shard <имя> <документов> <первый id> <последний id>
+
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "near_dup.h"  // mix64
+
+const std::string SHARDS_DIR = "shards";
+const std::string SHARDS_MANIFEST = "shards/shards.txt";
+
+struct ShardInfo {
+    std::string name;
+    size_t doc_count = 0;
+    int first_id = 0, last_id = 0;  // наименьший и наибольший id в базе
+};
+
+struct ShardManifest {
+    bool by_hash = false;
+    std::vector<ShardInfo> shards;
+
+    // шард документа; при делении по диапазонам id между шардами относятся к предыдущему
+    size_t shard_of(int id) const {
+        if (by_hash) return static_cast<size_t>(mix64(static_cast<uint64_t>(id)) % shards.size());
+        size_t s = 0;
+        while (s + 1 < shards.size() && shards[s + 1].first_id <= id) ++s;
+        return s;
+    }
+};
+
+inline bool read_shard_manifest(const std::string& path, ShardManifest& manifest) {
+    std::ifstream in(path);
+    if (!in.is_open()) return false;
+
+    manifest = ShardManifest();
+    std::string key;
+    while (in >> key) {
+        if (key == "by") {
+            std::string mode;
+            in >> mode;
+            manifest.by_hash = mode == "hash";
+        } else if (key == "shard") {
+            ShardInfo info;
+            in >> info.name >> info.doc_count >> info.first_id >> info.last_id;
+            manifest.shards.push_back(info);
+        } else {
+            return false;
+        }
+    }
+    return !manifest.shards.empty();
+}
+
+inline bool write_shard_manifest(const std::string& path, const ShardManifest& manifest) {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp);
+        if (!out.is_open()) return false;
+        out << "by " << (manifest.by_hash ? "hash" : "range") << "\n";
+        for (const auto& shard : manifest.shards) {
+            out << "shard " << shard.name << " " << shard.doc_count << " " << shard.first_id << " "
+                << shard.last_id << "\n";
+        }
+        if (!out) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    return !ec;
+}
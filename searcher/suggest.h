@@ -0,0 +1,210 @@
+// Подсказки по префиксу (indexer.exe строит, searcher.exe отвечает на "suggest <префикс>").
+//
+// Сжатое дерево префиксов над отсортированным словарём индекса, вес термина - число документов.
+// Узел - префикс, общий для диапазона терминов [lo, hi) словаря; дуга от родителя - байты,
+// на которые префикс узла длиннее родительского. В каждом узле заранее посчитаны top_k терминов
+// поддерева по весу, поэтому ответ - спуск на длину префикса и готовый список, posting листы не читаются.
+// Узлы хранятся только для поддеревьев больше top_k терминов: меньший диапазон дешевле
+// досмотреть в словаре при запросе, чем хранить для него список.
+//
+// suggest.bin (<сегмент>.sug для сегментов), числа uint32 в порядке байт машины, как в positions.bin:
+//   "SUG1", число терминов словаря, top_k, число узлов, байт дуг, элементов списков
+//   узлы по 8 чисел: начало и длина дуги, lo, hi, первый ребёнок, число детей, начало и длина списка
+//   байты дуг, номера терминов списков
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "term_dict.h"
+
+const uint32_t SUGGEST_TOP_K = 10;
+// глубина списков в файле: подсказки сегментов сливаются, и термин, лучший в сумме, может не войти
+// в первые SUGGEST_TOP_K ни одного сегмента; из более длинных списков он почти всегда попадает в кандидаты
+const uint32_t SUGGEST_MERGE_K = 4 * SUGGEST_TOP_K;
+
+struct CompletionNode {
+    uint32_t label_start = 0, label_len = 0;   // дуга от родителя
+    uint32_t lo = 0, hi = 0;                   // термины с префиксом узла
+    uint32_t first_child = 0, child_count = 0; // дети подряд, по возрастанию первого байта дуги
+    uint32_t top_start = 0, top_count = 0;     // лучшие термины поддерева по убыванию веса
+};
+
+class CompletionIndex {
+public:
+    // terms отсортированы и различны, weights[i] - число документов термина
+    void build(const std::vector<std::string>& terms, const std::vector<uint32_t>& weights,
+               uint32_t top_k = SUGGEST_TOP_K) {
+        nodes_.clear();
+        labels_.clear();
+        top_.clear();
+        term_count_ = static_cast<uint32_t>(terms.size());
+        top_k_ = top_k;
+        if (terms.empty()) return;
+        nodes_.resize(1);
+        fill_node(0, 0, terms.size(), 0, terms, weights);
+    }
+
+    bool write(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) return false;
+        out.write("SUG1", 4);
+        uint32_t header[5] = {term_count_, top_k_, static_cast<uint32_t>(nodes_.size()),
+                              static_cast<uint32_t>(labels_.size()), static_cast<uint32_t>(top_.size())};
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(nodes_.data()), nodes_.size() * sizeof(CompletionNode));
+        out.write(labels_.data(), labels_.size());
+        out.write(reinterpret_cast<const char*>(top_.data()), top_.size() * sizeof(uint32_t));
+        return static_cast<bool>(out);
+    }
+
+    bool load(const std::string& path) {
+        *this = CompletionIndex();
+        std::ifstream in(path, std::ios::binary);
+        char magic[4];
+        uint32_t header[5];
+        if (!in.read(magic, 4) || std::string(magic, 4) != "SUG1") return false;
+        if (!in.read(reinterpret_cast<char*>(header), sizeof(header))) return false;
+        nodes_.resize(header[2]);
+        labels_.resize(header[3]);
+        top_.resize(header[4]);
+        in.read(reinterpret_cast<char*>(nodes_.data()), nodes_.size() * sizeof(CompletionNode));
+        in.read(&labels_[0], labels_.size());
+        in.read(reinterpret_cast<char*>(top_.data()), top_.size() * sizeof(uint32_t));
+        if (!in) {
+            *this = CompletionIndex();
+            return false;
+        }
+        term_count_ = header[0];
+        top_k_ = header[1];
+        return true;
+    }
+
+    bool empty() const { return nodes_.empty(); }
+    uint32_t term_count() const { return term_count_; }
+    uint32_t top_k() const { return top_k_; }
+
+    size_t memory_bytes() const {
+        return nodes_.capacity() * sizeof(CompletionNode) + labels_.capacity() + top_.capacity() * sizeof(uint32_t);
+    }
+
+    // номера лучших по весу терминов с префиксом (не больше top_k); dict - словарь, по которому строилось
+    // дерево, weight(номер) - вес термина
+    template <typename Weight>
+    std::vector<uint32_t> complete(const TermDictionary& dict, const std::string& prefix, Weight weight) const {
+        if (nodes_.empty()) return {};
+        uint32_t node = 0;
+        if (!label_matches(nodes_[0], prefix, 0)) return {};
+        size_t depth = nodes_[0].label_len;
+        while (depth < prefix.size()) {
+            const CompletionNode& n = nodes_[node];
+            uint32_t next = 0;
+            bool found = false;
+            for (uint32_t c = n.first_child; c < n.first_child + n.child_count; ++c) {
+                if (labels_[nodes_[c].label_start] == prefix[depth]) {
+                    next = c;
+                    found = true;
+                    break;
+                }
+            }
+            // ребёнка нет - терминов с таким префиксом не больше top_k, они досматриваются в словаре
+            if (!found) return scan_range(dict, prefix, weight);
+            if (!label_matches(nodes_[next], prefix, depth)) return {};
+            depth += nodes_[next].label_len;
+            node = next;
+        }
+        const CompletionNode& n = nodes_[node];
+        return std::vector<uint32_t>(top_.begin() + n.top_start, top_.begin() + n.top_start + n.top_count);
+    }
+
+private:
+    // вес по убыванию, при равенстве - по алфавиту
+    template <typename Weight>
+    static void sort_by_weight(std::vector<uint32_t>& ids, size_t keep, Weight weight) {
+        auto better = [&weight](uint32_t a, uint32_t b) {
+            uint32_t wa = weight(a), wb = weight(b);
+            return wa != wb ? wa > wb : a < b;
+        };
+        if (ids.size() > keep) {
+            std::partial_sort(ids.begin(), ids.begin() + keep, ids.end(), better);
+            ids.resize(keep);
+        } else {
+            std::sort(ids.begin(), ids.end(), better);
+        }
+    }
+
+    std::vector<uint32_t> fill_node(uint32_t slot, size_t lo, size_t hi, size_t parent_depth,
+                                    const std::vector<std::string>& terms, const std::vector<uint32_t>& weights) {
+        // префикс узла - общий префикс первого и последнего термина диапазона
+        const std::string& first = terms[lo];
+        const std::string& last = terms[hi - 1];
+        size_t depth = parent_depth;
+        while (depth < first.size() && depth < last.size() && first[depth] == last[depth]) ++depth;
+
+        nodes_[slot].label_start = static_cast<uint32_t>(labels_.size());
+        nodes_[slot].label_len = static_cast<uint32_t>(depth - parent_depth);
+        nodes_[slot].lo = static_cast<uint32_t>(lo);
+        nodes_[slot].hi = static_cast<uint32_t>(hi);
+        labels_.append(first, parent_depth, depth - parent_depth);
+
+        // кандидаты: сам префикс (если это термин), термины маленьких поддеревьев, списки детей
+        std::vector<uint32_t> candidates;
+        size_t i = lo;
+        if (terms[i].size() == depth) candidates.push_back(static_cast<uint32_t>(i++));
+        std::vector<std::pair<size_t, size_t>> big;
+        while (i < hi) {
+            size_t j = i;
+            while (j < hi && terms[j][depth] == terms[i][depth]) ++j;
+            if (j - i > top_k_) {
+                big.emplace_back(i, j);
+            } else {
+                for (size_t t = i; t < j; ++t) candidates.push_back(static_cast<uint32_t>(t));
+            }
+            i = j;
+        }
+
+        uint32_t first_child = static_cast<uint32_t>(nodes_.size());
+        nodes_.resize(nodes_.size() + big.size());
+        nodes_[slot].first_child = first_child;
+        nodes_[slot].child_count = static_cast<uint32_t>(big.size());
+        for (size_t c = 0; c < big.size(); ++c) {
+            std::vector<uint32_t> child = fill_node(first_child + static_cast<uint32_t>(c), big[c].first,
+                                                    big[c].second, depth, terms, weights);
+            candidates.insert(candidates.end(), child.begin(), child.end());
+        }
+
+        sort_by_weight(candidates, top_k_, [&weights](uint32_t t) { return weights[t]; });
+        nodes_[slot].top_start = static_cast<uint32_t>(top_.size());
+        nodes_[slot].top_count = static_cast<uint32_t>(candidates.size());
+        top_.insert(top_.end(), candidates.begin(), candidates.end());
+        return candidates;
+    }
+
+    bool label_matches(const CompletionNode& node, const std::string& prefix, size_t depth) const {
+        size_t len = std::min<size_t>(node.label_len, prefix.size() - std::min(depth, prefix.size()));
+        return labels_.compare(node.label_start, len, prefix, depth, len) == 0;
+    }
+
+    template <typename Weight>
+    std::vector<uint32_t> scan_range(const TermDictionary& dict, const std::string& prefix, Weight weight) const {
+        std::vector<uint32_t> ids;
+        dict.scan(dict.lower_bound(prefix), [&](size_t idx, const std::string& term) {
+            if (term.compare(0, prefix.size(), prefix) != 0) return false;
+            ids.push_back(static_cast<uint32_t>(idx));
+            return true;
+        });
+        sort_by_weight(ids, top_k_, weight);
+        return ids;
+    }
+
+    std::vector<CompletionNode> nodes_;
+    std::string labels_;
+    std::vector<uint32_t> top_;
+    uint32_t term_count_ = 0;
+    uint32_t top_k_ = SUGGEST_TOP_K;
+};
@@ -0,0 +1,257 @@
+// Словарь терминов searcher.exe: отсортированные термины сжаты front coding'ом.
+//
+// Термины идут блоками по TERM_BLOCK_SIZE. Первый термин блока хранится целиком, у остальных -
+// длина общего префикса с предыдущим термином и остаток (у русских основ общие префиксы длинные).
+// Все блоки лежат в одном буфере. Для каждого блока отдельно хранятся смещение и первые 8 байт
+// первого термина числом: бинарный поиск идёт по этому плотному массиву и в буфер заглядывает
+// только при совпадении 8 байт. Затем разбирается один блок, без сборки терминов в строки.
+// Номер термина в словаре - номер его posting листа.
+//
+// Запись в буфере (длины - varint):
+//   первый термин блока: длина, байты
+//   остальные: длина общего префикса, длина остатка, байты остатка
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+const size_t TERM_BLOCK_SIZE = 16;
+
+class TermDictionary {
+public:
+    // термины добавляются по возрастанию (порядок boolean_index.txt)
+    void add(const std::string& term) {
+        if (count_ % TERM_BLOCK_SIZE == 0) {
+            block_starts_.push_back(data_.size());
+            block_keys_.push_back(key_of(term));
+            put_length(term.size());
+            data_ += term;
+        } else {
+            size_t shared = 0;
+            size_t limit = std::min(prev_.size(), term.size());
+            while (shared < limit && prev_[shared] == term[shared]) ++shared;
+            put_length(shared);
+            put_length(term.size() - shared);
+            data_.append(term, shared, std::string::npos);
+        }
+        prev_ = term;
+        ++count_;
+    }
+
+    // после загрузки: лишняя ёмкость буферов больше не нужна
+    void finish() {
+        data_.shrink_to_fit();
+        block_starts_.shrink_to_fit();
+        block_keys_.shrink_to_fit();
+        prev_.clear();
+        prev_.shrink_to_fit();
+    }
+
+    size_t size() const { return count_; }
+
+    // байт в памяти (для отчёта при загрузке)
+    size_t memory_bytes() const {
+        return data_.capacity() + block_starts_.capacity() * sizeof(size_t) + block_keys_.capacity() * sizeof(uint64_t);
+    }
+
+    // номер термина или -1
+    long long find(const std::string& term) const {
+        // последний блок, первый термин которого не больше искомого
+        uint64_t key = key_of(term);
+        size_t left = 0, right = block_starts_.size();
+        while (left < right) {
+            size_t mid = (left + right) / 2;
+            if (block_keys_[mid] < key || (block_keys_[mid] == key && compare_first(mid, term) <= 0)) {
+                left = mid + 1;
+            } else {
+                right = mid;
+            }
+        }
+        if (left == 0) return -1;
+        return find_in_block(left - 1, term);
+    }
+
+    // последовательное чтение словаря: термин раскодируется из предыдущего,
+    // переход в другое место словаря начинается с начала блока
+    class Cursor {
+    public:
+        explicit Cursor(const TermDictionary& dict) : dict_(&dict) {}
+
+        bool valid() const { return idx_ < dict_->count_; }
+        size_t index() const { return idx_; }
+        const std::string& term() const { return term_; }
+
+        void next() {
+            if (++idx_ < dict_->count_) decode();
+        }
+
+        // к термину с номером idx
+        void seek_index(size_t idx) {
+            if (idx >= dict_->count_) {
+                idx_ = dict_->count_;
+                return;
+            }
+            idx_ = idx - idx % TERM_BLOCK_SIZE;
+            decode();
+            while (idx_ < idx) next();
+        }
+
+        // к первому термину, который не меньше target
+        void seek(const std::string& target) {
+            // все термины блоков до block меньше target: первый подходящий - в блоке block - 1 или первый в block
+            size_t block = dict_->blocks_less_than(target);
+            seek_index(block == 0 ? 0 : (block - 1) * TERM_BLOCK_SIZE);
+            while (valid() && term_ < target) next();
+        }
+
+    private:
+        void decode() {
+            if (idx_ % TERM_BLOCK_SIZE == 0) {
+                pos_ = dict_->block_starts_[idx_ / TERM_BLOCK_SIZE];
+                size_t len = dict_->get_length(pos_);
+                term_.assign(dict_->data_, pos_, len);
+                pos_ += len;
+            } else {
+                size_t shared = dict_->get_length(pos_);
+                size_t rest = dict_->get_length(pos_);
+                term_.resize(shared);
+                term_.append(dict_->data_, pos_, rest);
+                pos_ += rest;
+            }
+        }
+
+        const TermDictionary* dict_;
+        size_t idx_ = 0;
+        size_t pos_ = 0;
+        std::string term_;
+    };
+
+    // термин по номеру (раскодирует начало его блока)
+    std::string term(size_t idx) const {
+        Cursor cursor(*this);
+        cursor.seek_index(idx);
+        return cursor.valid() ? cursor.term() : std::string();
+    }
+
+    // номер первого термина, который не меньше term (size(), если таких нет)
+    size_t lower_bound(const std::string& term) const {
+        Cursor cursor(*this);
+        cursor.seek(term);
+        return cursor.index();
+    }
+
+    // термины по порядку начиная с from: fn(номер, термин), пока fn возвращает true
+    template <typename Fn>
+    void scan(size_t from, Fn fn) const {
+        Cursor cursor(*this);
+        cursor.seek_index(from);
+        while (cursor.valid() && fn(cursor.index(), cursor.term())) cursor.next();
+    }
+
+private:
+    // первые 8 байт термина как число с тем же порядком, что у строк (в терминах нет байта 0)
+    static uint64_t key_of(const std::string& term) {
+        uint64_t key = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            key <<= 8;
+            if (i < term.size()) key |= static_cast<unsigned char>(term[i]);
+        }
+        return key;
+    }
+
+    // число блоков, первый термин которых меньше term
+    size_t blocks_less_than(const std::string& term) const {
+        uint64_t key = key_of(term);
+        size_t left = 0, right = block_starts_.size();
+        while (left < right) {
+            size_t mid = (left + right) / 2;
+            if (block_keys_[mid] < key || (block_keys_[mid] == key && compare_first(mid, term) < 0)) {
+                left = mid + 1;
+            } else {
+                right = mid;
+            }
+        }
+        return left;
+    }
+
+    void put_length(size_t value) {
+        while (value >= 0x80) {
+            data_ += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        data_ += static_cast<char>(value);
+    }
+
+    size_t get_length(size_t& pos) const {
+        unsigned char first = static_cast<unsigned char>(data_[pos]);
+        if (first < 0x80) {
+            ++pos;
+            return first;
+        }
+        size_t value = 0;
+        int shift = 0;
+        while (pos < data_.size()) {
+            unsigned char byte = static_cast<unsigned char>(data_[pos++]);
+            value |= static_cast<size_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+            shift += 7;
+        }
+        return value;
+    }
+
+    // сравнение первого термина блока с term: <0, 0, >0
+    int compare_first(size_t block, const std::string& term) const {
+        size_t pos = block_starts_[block];
+        size_t len = get_length(pos);
+        int cmp = std::memcmp(data_.data() + pos, term.data(), std::min(len, term.size()));
+        if (cmp != 0) return cmp;
+        return len < term.size() ? -1 : (len > term.size() ? 1 : 0);
+    }
+
+    // matched - длина общего префикса текущего термина блока с искомым. Термины блока растут,
+    // поэтому по длине общего префикса со следующим термином сразу видно, с какой стороны он
+    // от искомого, а байты сравниваются только там, где он может с искомым совпасть.
+    long long find_in_block(size_t block, const std::string& term) const {
+        size_t pos = block_starts_[block];
+        size_t idx = block * TERM_BLOCK_SIZE;
+        size_t end = std::min(idx + TERM_BLOCK_SIZE, count_);
+        size_t len = get_length(pos);
+        size_t matched = 0;
+        while (matched < len && matched < term.size() && data_[pos + matched] == term[matched]) ++matched;
+        pos += len;
+        if (matched == len && len == term.size()) return static_cast<long long>(idx);
+
+        for (++idx; idx < end; ++idx) {
+            size_t shared = get_length(pos);
+            size_t rest = get_length(pos);
+            const char* suffix = data_.data() + pos;
+            pos += rest;
+            // shared > matched: термин отличается от искомого там же, где предыдущий, - он ещё меньше
+            if (shared > matched) continue;
+            // shared < matched: на позиции shared байт больше, чем у предыдущего, то есть больше искомого
+            if (shared < matched) return -1;
+            size_t i = 0;
+            while (i < rest && matched < term.size() && suffix[i] == term[matched]) {
+                ++i;
+                ++matched;
+            }
+            if (i == rest) {
+                if (matched == term.size()) return static_cast<long long>(idx);
+                continue;  // термин - собственный префикс искомого
+            }
+            if (matched == term.size()) return -1;  // искомое - префикс термина
+            if (static_cast<unsigned char>(suffix[i]) > static_cast<unsigned char>(term[matched])) return -1;
+        }
+        return -1;
+    }
+
+    std::string data_;
+    std::vector<size_t> block_starts_;
+    std::vector<uint64_t> block_keys_;
+    std::string prev_;
+    size_t count_ = 0;
+};
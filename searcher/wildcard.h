@@ -0,0 +1,190 @@
+// Запросы с * (searcher.exe): корм*, *корм*, к*м.
+//
+// Шаблон вида "префикс*" - диапазон отсортированного словаря, он просматривается от lower_bound.
+// Остальные шаблоны ищутся через индекс триграмм словаря: для каждого термина запоминаются
+// триграммы символов (не байт) с границами слова, "$кор", "орм$" и т.п. Кандидаты - пересечение
+// списков триграмм из кусков шаблона между *, затем каждый кандидат проверяется по шаблону
+// (триграммы не учитывают порядок кусков). Если в шаблоне нет ни одной триграммы (*ы, к*),
+// просматривается диапазон префикса или весь словарь.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "term_dict.h"
+
+// длина UTF-8 последовательности по первому байту
+inline size_t utf8_sequence_length(unsigned char c) {
+    return c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 1;
+}
+
+// символ, который начинается в s с байта pos; len - длина его последовательности
+inline uint32_t utf8_code_point(const std::string& s, size_t pos, size_t len) {
+    unsigned char c = static_cast<unsigned char>(s[pos]);
+    uint32_t cp = len == 1 ? c : c & (0x7F >> len);
+    for (size_t k = 1; k < len && pos + k < s.size(); ++k) {
+        cp = (cp << 6) | (static_cast<unsigned char>(s[pos + k]) & 0x3F);
+    }
+    return cp;
+}
+
+// символы UTF-8 строки как кодовые точки
+inline std::vector<uint32_t> utf8_code_points(const std::string& s) {
+    std::vector<uint32_t> result;
+    for (size_t i = 0; i < s.size();) {
+        size_t len = utf8_sequence_length(static_cast<unsigned char>(s[i]));
+        result.push_back(utf8_code_point(s, i, len));
+        i += len;
+    }
+    return result;
+}
+
+// граница слова в триграммах; байта 0 в терминах нет
+const uint32_t TRIGRAM_BOUNDARY = 0;
+
+inline uint64_t trigram_key(uint32_t a, uint32_t b, uint32_t c) {
+    return (static_cast<uint64_t>(a) << 42) | (static_cast<uint64_t>(b) << 21) | c;
+}
+
+// триграммы последовательности символов (границы уже добавлены вызывающим)
+inline void append_trigrams(const std::vector<uint32_t>& chars, std::vector<uint64_t>& out) {
+    for (size_t i = 0; i + 3 <= chars.size(); ++i) out.push_back(trigram_key(chars[i], chars[i + 1], chars[i + 2]));
+}
+
+// совпадение термина с шаблоном; * - любая последовательность байт (UTF-8 сравнивается побайтно)
+inline bool wildcard_match(const std::string& pattern, const std::string& term) {
+    size_t p = 0, t = 0;
+    size_t star = std::string::npos, resume = 0;
+    while (t < term.size()) {
+        if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            resume = t;
+        } else if (p < pattern.size() && pattern[p] == term[t]) {
+            ++p;
+            ++t;
+        } else if (star != std::string::npos) {
+            p = star + 1;
+            t = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+}
+
+// шаблон без * в середине и в начале: "корм*"
+inline bool is_prefix_pattern(const std::string& pattern) {
+    size_t star = pattern.find('*');
+    return star != std::string::npos && star > 0 && pattern.find_first_not_of('*', star) == std::string::npos;
+}
+
+// индекс триграмм словаря: ключи по возрастанию, для каждого - номера терминов по возрастанию
+class TrigramIndex {
+public:
+    void build(const TermDictionary& dict) {
+        std::vector<std::pair<uint64_t, uint32_t>> pairs;
+        std::vector<uint64_t> grams;
+        dict.scan(0, [&](size_t idx, const std::string& term) {
+            std::vector<uint32_t> chars = utf8_code_points(term);
+            chars.insert(chars.begin(), TRIGRAM_BOUNDARY);
+            chars.push_back(TRIGRAM_BOUNDARY);
+            grams.clear();
+            append_trigrams(chars, grams);
+            for (uint64_t g : grams) pairs.emplace_back(g, static_cast<uint32_t>(idx));
+            return true;
+        });
+        std::sort(pairs.begin(), pairs.end());
+        pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+        keys_.clear();
+        starts_.clear();
+        terms_.clear();
+        terms_.reserve(pairs.size());
+        for (const auto& p : pairs) {
+            if (keys_.empty() || keys_.back() != p.first) {
+                keys_.push_back(p.first);
+                starts_.push_back(static_cast<uint32_t>(terms_.size()));
+            }
+            terms_.push_back(p.second);
+        }
+        starts_.push_back(static_cast<uint32_t>(terms_.size()));
+        keys_.shrink_to_fit();
+        starts_.shrink_to_fit();
+    }
+
+    size_t memory_bytes() const {
+        return keys_.capacity() * sizeof(uint64_t) + (starts_.capacity() + terms_.capacity()) * sizeof(uint32_t);
+    }
+
+    // кандидаты для шаблона; false - в шаблоне нет ни одной триграммы, индекс не помогает
+    bool candidates(const std::string& pattern, std::vector<uint32_t>& out) const {
+        std::vector<uint64_t> grams;
+        size_t begin = 0;
+        while (begin <= pattern.size()) {
+            size_t end = pattern.find('*', begin);
+            if (end == std::string::npos) end = pattern.size();
+            std::vector<uint32_t> chars = utf8_code_points(pattern.substr(begin, end - begin));
+            if (begin == 0) chars.insert(chars.begin(), TRIGRAM_BOUNDARY);
+            if (end == pattern.size()) chars.push_back(TRIGRAM_BOUNDARY);
+            append_trigrams(chars, grams);
+            begin = end + 1;
+        }
+        if (grams.empty()) return false;
+
+        // самые короткие списки первыми: пересечение сразу становится маленьким
+        std::vector<std::pair<uint32_t, uint32_t>> lists;
+        for (uint64_t g : grams) {
+            auto it = std::lower_bound(keys_.begin(), keys_.end(), g);
+            if (it == keys_.end() || *it != g) {
+                out.clear();
+                return true;
+            }
+            size_t k = static_cast<size_t>(it - keys_.begin());
+            lists.emplace_back(starts_[k], starts_[k + 1]);
+        }
+        std::sort(lists.begin(), lists.end(), [](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b) {
+            return a.second - a.first < b.second - b.first;
+        });
+        out.assign(terms_.begin() + lists[0].first, terms_.begin() + lists[0].second);
+        std::vector<uint32_t> next;
+        for (size_t i = 1; i < lists.size() && !out.empty(); ++i) {
+            next.clear();
+            std::set_intersection(out.begin(), out.end(), terms_.begin() + lists[i].first,
+                                  terms_.begin() + lists[i].second, std::back_inserter(next));
+            out.swap(next);
+        }
+        return true;
+    }
+
+private:
+    std::vector<uint64_t> keys_;
+    std::vector<uint32_t> starts_;
+    std::vector<uint32_t> terms_;
+};
+
+// номера терминов словаря, подходящих под шаблон, по возрастанию
+inline std::vector<uint32_t> expand_wildcard(const TermDictionary& dict, const TrigramIndex& trigrams,
+                                             const std::string& pattern) {
+    std::vector<uint32_t> result;
+    std::string prefix = pattern.substr(0, pattern.find('*'));
+    if (!is_prefix_pattern(pattern)) {
+        std::vector<uint32_t> found;
+        if (trigrams.candidates(pattern, found)) {
+            for (uint32_t idx : found) {
+                if (wildcard_match(pattern, dict.term(idx))) result.push_back(idx);
+            }
+            return result;
+        }
+    }
+    dict.scan(dict.lower_bound(prefix), [&](size_t idx, const std::string& term) {
+        if (term.compare(0, prefix.size(), prefix) != 0) return false;
+        if (wildcard_match(pattern, term)) result.push_back(static_cast<uint32_t>(idx));
+        return true;
+    });
+    return result;
+}